@@ -0,0 +1,153 @@
+// -----------------------------------------------------------------------
+//  <copyright file="OrderedPrefetcher.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace EDL;
+
+// Prepares a sequence of items on a number of threads, no more than a given number ahead of
+// the single consumer, which takes them strictly in order. An error preparing an item is
+// passed on to the consumer when it reaches that item, just as if it had prepared it itself.
+// The number of items need not be known in advance; each is begun in turn, one at a time,
+// eg by reading the next line of a list, until there are no more.
+template <typename T>
+class OrderedPrefetcher
+{
+public:
+    typedef std::function<bool(uint32 index, T& item)> BeginFunc;      // False if there are no more items
+    typedef std::function<void(uint32 index, T& item)> PrepareFunc;
+
+    OrderedPrefetcher(uint32 threadCount, uint32 lookahead, BeginFunc begin, PrepareFunc prepare) :
+        m_lookahead(lookahead ? lookahead : 1), m_begin(begin), m_prepare(prepare), m_next(0), m_taken(0), m_ended(false), m_stopping(false)
+    {
+        for (uint32 i = 0; i < (threadCount ? threadCount : 1); i++)
+            m_threads.push_back(std::thread(&OrderedPrefetcher::run, this));
+    }
+
+    // A fixed number of items
+    OrderedPrefetcher(uint32 count, uint32 threadCount, uint32 lookahead, PrepareFunc prepare) :
+        OrderedPrefetcher(threadCount, lookahead, [count](uint32 index, T&) { return index < count; }, prepare)
+    {
+    }
+
+    // Items not yet taken are abandoned, once those being prepared are finished
+    ~OrderedPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_changed.notify_all();
+        for (auto& thread : m_threads)
+            thread.join();
+    }
+
+    // Take the next item, waiting for it to be prepared. Returns false once every item has been taken.
+    bool take(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const uint32 index = m_taken;
+        m_changed.wait(lock, [this, index] { return m_ready.find(index) != m_ready.end() || (m_ended && index >= m_next); });
+        if (m_ready.find(index) == m_ready.end())
+            return false;
+
+        sSlot slot = std::move(m_ready[index]);
+        m_ready.erase(index);
+        m_taken++;
+        lock.unlock();
+        m_changed.notify_all();
+
+        if (slot.error)
+            std::rethrow_exception(slot.error);
+        item = std::move(slot.item);
+        return true;
+    }
+
+private:
+    struct sSlot
+    {
+        T item;
+        std::exception_ptr error;
+    };
+
+    void run()
+    {
+        for (;;)
+        {
+            uint32 index;
+            sSlot slot;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_changed.wait(lock, [this] { return m_stopping || m_ended || m_next < m_taken + m_lookahead; });
+                if (m_stopping || m_ended)
+                    return;
+
+                // Items are begun in order, under the lock; an error beginning one ends the sequence there
+                index = m_next;
+                try
+                {
+                    if (!m_begin(index, slot.item))
+                    {
+                        m_ended = true;
+                        lock.unlock();
+                        m_changed.notify_all();
+                        return;
+                    }
+                }
+                catch (...)
+                {
+                    slot.error = std::current_exception();
+                    m_ended = true;
+                }
+                m_next++;
+            }
+
+            if (!slot.error)
+            {
+                try
+                {
+                    m_prepare(index, slot.item);
+                }
+                catch (...)
+                {
+                    slot.error = std::current_exception();
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_ready[index] = std::move(slot);
+            }
+            m_changed.notify_all();
+        }
+    }
+
+    const uint32 m_lookahead;
+    BeginFunc m_begin;
+    PrepareFunc m_prepare;
+    uint32 m_next;
+    uint32 m_taken;
+    bool m_ended;
+    bool m_stopping;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::map<uint32, sSlot> m_ready;
+    std::vector<std::thread> m_threads;
+};
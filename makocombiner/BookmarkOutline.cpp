@@ -0,0 +1,106 @@
+// -----------------------------------------------------------------------
+//  <copyright file="BookmarkOutline.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "BookmarkOutline.h"
+
+#include <jawsmako/jawsmako.h>
+
+// Walk the outline with a stack of the entries above the current one rather than by recursion
+BookmarkOutline::BookmarkOutline(const IDocumentPtr& document, const PageIdIndex& sourcePages)
+{
+    IDOMOutlinePtr outline = document->getOutline();
+    if (!outline)
+        return;
+
+    struct sLevel
+    {
+        IDOMOutlineTreeNodePtr node;
+        uint32 nextChild;
+        size_t position;
+    };
+
+    std::vector<sLevel> stack;
+    stack.push_back({ outline->getOutlineTree()->getRoot(), 0, 0 });
+    while (!stack.empty())
+    {
+        sLevel& level = stack.back();
+        if (level.nextChild == level.node->getChildrenCount())
+        {
+            // All the descendants of this entry have been added
+            if (stack.size() > 1)
+                m_entries[level.position].subtreeEnd = (uint32)m_entries.size();
+            stack.pop_back();
+            continue;
+        }
+
+        IDOMOutlineTreeNodePtr child = level.node->getChild(level.nextChild++);
+        sEntry entry = { IDOMOutlineEntryPtr(), IDOMPageRectTargetPtr(), -1, (uint32)stack.size() - 1, 0 };
+        uint32 pageIndex;
+        IDOMTargetPtr target;
+        if (child->getData(entry.outline) && entry.outline->getTarget(target))
+        {
+            entry.target = edlobj2IDOMPageRectTarget(target);
+            const IDOMPageTargetPtr pageTarget = entry.target ? IDOMPageTargetPtr() : edlobj2IDOMPageTarget(target);
+            if (entry.target && sourcePages.findPageIndex(entry.target->getPageId(), pageIndex))
+                entry.pageIndex = (int)pageIndex;
+            else if (pageTarget && pageTarget->getTargetPage() && pageTarget->getTargetPage() <= sourcePages.getCount())
+                entry.pageIndex = (int)pageTarget->getTargetPage() - 1;
+        }
+
+        m_entries.push_back(entry);
+        stack.push_back({ child, 0, m_entries.size() - 1 });
+    }
+}
+
+void BookmarkOutline::appendRange(const IDOMOutlineTreeNodePtr& targetOutline, const int startPageIndex, const int endPageIndex,
+    const int sourceToTargetPageDelta, const PageIdIndex& targetPages, const IJawsMakoPtr& mako) const
+{
+    // Copy the entries for the range, skipping past the descendants of any entry that is not copied
+    std::vector<IDOMOutlineTreeNodePtr> parents;
+    parents.push_back(targetOutline);
+    uint32 position = 0;
+    while (position < m_entries.size())
+    {
+        const sEntry& entry = m_entries[position];
+        if (entry.pageIndex < startPageIndex || entry.pageIndex > endPageIndex)
+        {
+            position = entry.subtreeEnd;
+            continue;
+        }
+
+        IDOMOutlineTreeNodePtr node = createInstance<IDOMOutlineTreeNode>(mako, CClassID(IDOMOutlineTreeNodeClassID));
+        if (!node)
+        {
+            position = entry.subtreeEnd;
+            continue;
+        }
+
+        // Clone target, and update page id, or page number
+        const uint32 targetPageIndex = (uint32)(entry.pageIndex + sourceToTargetPageDelta);
+        IDOMOutlineEntryPtr clonedOutline = clone(entry.outline, mako);
+        const IDOMPageRectTargetPtr& target = entry.target;
+        if (target)
+            clonedOutline->setTarget(IDOMPageRectTarget::create(mako, targetPages.getPageId(targetPageIndex), target->getFitType(), target->getZoom(), target->getLeft(), target->getTop(), target->getRight(), target->getBottom()));
+        else
+        {
+            IDOMPageTargetPtr pageTarget = createInstance<IDOMPageTarget>(mako, CClassID(IDOMPageTargetClassID));
+            pageTarget->setTargetPage(targetPageIndex + 1);
+            clonedOutline->setTarget(pageTarget);
+        }
+        node->setData(clonedOutline);
+
+        // Entries are only visited once their parent has been copied, so parents[depth] is the parent of this one
+        parents.resize(entry.depth + 1);
+        parents[entry.depth]->appendChild(node);
+        parents.push_back(node);
+        position++;
+    }
+}
@@ -0,0 +1,58 @@
+// -----------------------------------------------------------------------
+//  <copyright file="BookmarkOutline.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+#include <edl/idomoutline.h>
+
+#include <vector>
+
+#include "PageIdIndex.h"
+
+using namespace EDL;
+using namespace JawsMako;
+
+// The outline (bookmarks) of a document, flattened into a single array in the order of a depth-first walk,
+// each entry linked to the entry that follows its descendants. It is built once for a document, without
+// recursion however deep the outline is, and copies of any range of its pages take their share of it.
+class BookmarkOutline
+{
+public:
+    BookmarkOutline()
+    {
+    }
+
+    // Flatten the outline of a document, finding the page each bookmark targets in the index of the document
+    BookmarkOutline(const IDocumentPtr& document, const PageIdIndex& sourcePages);
+
+    bool empty() const
+    {
+        return m_entries.empty();
+    }
+
+    // Append the bookmarks that target the given range of source pages to an outline node, in order.
+    // A bookmark is only appended if its parent is. The range is copied to the target pages starting at
+    // startPageIndex + sourceToTargetPageDelta.
+    void appendRange(const IDOMOutlineTreeNodePtr& targetOutline, int startPageIndex, int endPageIndex,
+        int sourceToTargetPageDelta, const PageIdIndex& targetPages, const IJawsMakoPtr& mako) const;
+
+private:
+    struct sEntry
+    {
+        IDOMOutlineEntryPtr outline;
+        IDOMPageRectTargetPtr target;       // Or null if the target is a page number, eg one added by makocombiner
+        int pageIndex;          // -1 if the bookmark does not target a page of the document
+        uint32 depth;
+        uint32 subtreeEnd;      // The position of the entry that follows this entry's descendants
+    };
+
+    std::vector<sEntry> m_entries;
+};
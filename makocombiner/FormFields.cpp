@@ -0,0 +1,120 @@
+// -----------------------------------------------------------------------
+//  <copyright file="FormFields.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "FormFields.h"
+
+FormFields::FormFields(const IJawsMakoPtr& mako) : m_mako(mako), m_sourceIndex(0)
+{
+}
+
+void FormFields::appendExisting(const IFormPtr& form)
+{
+    m_sourceIndex++;
+    if (!form)
+        return;
+
+    CFormFieldVect fields = form->getFields();
+    for (uint32 i = 0; i < fields.size(); i++)
+        append(fields[i]);
+}
+
+void FormFields::appendCopied(const IFormPtr& form, const std::vector<IPagePtr>& copiedPages)
+{
+    m_sourceIndex++;
+    if (!form)
+        return;
+
+    CFormFieldVect fields = form->getFields();
+    if (fields.empty())
+        return;
+
+    // The widgets on the copied pages, so each field is checked with a lookup rather than a search of the pages
+    std::unordered_set<const void*> copiedWidgets;
+    for (const auto& page : copiedPages)
+    {
+        CAnnotationVect annotations = page->getAnnotations();
+        for (uint32 i = 0; i < annotations.size(); i++)
+            copiedWidgets.insert(&*annotations[i]);
+    }
+
+    for (uint32 i = 0; i < fields.size(); i++)
+    {
+        if (hasCopiedWidget(fields[i], copiedWidgets))
+            append(fields[i]);
+    }
+}
+
+// Walk a field and its descendants, with a stack rather than by recursion, for a widget on a copied page
+bool FormFields::hasCopiedWidget(const IFormFieldPtr& field, const std::unordered_set<const void*>& copiedWidgets)
+{
+    std::vector<IFormFieldPtr> stack;
+    stack.push_back(field);
+    while (!stack.empty())
+    {
+        const IFormFieldPtr current = stack.back();
+        stack.pop_back();
+
+        CAnnotationVect widgets = current->getWidgets();
+        for (uint32 i = 0; i < widgets.size(); i++)
+        {
+            if (copiedWidgets.find(&*widgets[i]) != copiedWidgets.end())
+                return true;
+        }
+
+        CFormFieldVect children = current->getChildren();
+        for (uint32 i = 0; i < children.size(); i++)
+            stack.push_back(children[i]);
+    }
+    return false;
+}
+
+void FormFields::dropWidgets(const IPagePtr& page)
+{
+    CAnnotationVect annotations = page->getAnnotations();
+    CAnnotationVect kept;
+    for (uint32 i = 0; i < annotations.size(); i++)
+    {
+        if (annotations[i]->getType() != IAnnotation::eATWidget)
+            kept.append(annotations[i]);
+    }
+    if (kept.size() != annotations.size())
+        page->setAnnotations(kept);
+}
+
+// Appends a top-level field, renaming it should its name be taken. Descendants are named relative to it, so they
+// cannot clash with the fields of another input once it is unique. The field may belong to an input kept for reuse,
+// so it is a copy that is renamed.
+void FormFields::append(const IFormFieldPtr& field)
+{
+    const std::string name = StringToU8String(field->getName()).c_str();
+    if (m_names.insert(name).second)
+    {
+        m_fields.append(field);
+        return;
+    }
+
+    // name already taken. A period separates the parts of a field's full name, so is not used.
+    const std::string qualifiedName = name + "_" + std::to_string(m_sourceIndex);
+    std::string uniqueName = qualifiedName;
+    for (uint32 count = 2; !m_names.insert(uniqueName).second; count++)
+        uniqueName = qualifiedName + "_" + std::to_string(count);
+
+    IFormFieldPtr renamedField = clone(field, m_mako);
+    renamedField->setName(U8StringToString(uniqueName.c_str()));
+    m_fields.append(renamedField);
+}
+
+IFormPtr FormFields::getForm() const
+{
+    IFormPtr form = IForm::create(m_mako);
+    form->setFields(m_fields);
+    return form;
+}
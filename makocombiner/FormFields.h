@@ -0,0 +1,59 @@
+// -----------------------------------------------------------------------
+//  <copyright file="FormFields.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// The form fields (AcroForm) of the output, gathered from the form of each input, so that forms keep working
+// without the pages being appended with a deep copy. The widgets of the fields travel with the pages they are on,
+// so only the field tree need be merged: a field is kept if any of its widgets is on a page that was copied.
+// Fields with the same name in different inputs would become the one field, sharing a value, so a top-level
+// field whose name is taken is renamed, on a copy so that the input's own form is left as it was.
+class FormFields
+{
+public:
+    FormFields(const IJawsMakoPtr& mako);
+
+    // Start from the fields of a document that is being added to, so that they are kept
+    void appendExisting(const IFormPtr& form);
+
+    // Add the fields of an input that have a widget on one of the pages copied from it. A top-level field whose
+    // name is taken is renamed <name>_<n>, n being the position of the input, with a further _2, _3 and so on
+    // should that also be taken, so the result is the same from run to run.
+    void appendCopied(const IFormPtr& form, const std::vector<IPagePtr>& copiedPages);
+
+    // Remove the widgets from a copy of a page whose fields are already in the output, as there is no field for them
+    static void dropWidgets(const IPagePtr& page);
+
+    bool empty() const
+    {
+        return m_fields.empty();
+    }
+
+    // A form holding the fields
+    IFormPtr getForm() const;
+
+private:
+    static bool hasCopiedWidget(const IFormFieldPtr& field, const std::unordered_set<const void*>& copiedWidgets);
+    void append(const IFormFieldPtr& field);
+
+    IJawsMakoPtr m_mako;
+    CFormFieldVect m_fields;
+    std::unordered_set<std::string> m_names;
+    uint32 m_sourceIndex;    // Counts the inputs appended from, for renaming clashes
+};
@@ -0,0 +1,238 @@
+// -----------------------------------------------------------------------
+//  <copyright file="InputCache.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "InputCache.h"
+
+#include <stdio.h>
+#include <sys/stat.h>
+
+static FILE* openFile(const String& path, const char* mode)
+{
+#ifdef _WIN32
+    return _wfopen(path.c_str(), U8StringToString(mode).c_str());
+#else
+    return fopen(StringToU8String(path).c_str(), mode);
+#endif
+}
+
+static bool fileSize(const String& path, uint64& bytes)
+{
+#ifdef _WIN32
+    struct _stat64 statBuff;
+    if (_wstat64(path.c_str(), &statBuff) != 0)
+        return false;
+#else
+    struct stat statBuff;
+    if (stat(StringToU8String(path).c_str(), &statBuff) != 0)
+        return false;
+#endif
+    bytes = (uint64)statBuff.st_size;
+    return true;
+}
+
+// 64-bit FNV-1a hash of a file's contents
+static bool hashFile(const String& path, uint64& hash)
+{
+    FILE* file = openFile(path, "rb");
+    if (!file)
+        return false;
+
+    std::vector<uint8> buffer(1024 * 1024);
+    hash = 0xCBF29CE484222325ULL;
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+    {
+        for (size_t i = 0; i < bytesRead; i++)
+            hash = (hash ^ buffer[i]) * 0x100000001B3ULL;
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    return !failed;
+}
+
+void sOpenedInput::keepPage(const IPagePtr& page)
+{
+    if (evicted)
+        page->release();
+    else
+        keptPages.push_back(page);
+}
+
+void sOpenedInput::releaseKeptPages()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    evicted = true;
+    for (const auto& page : keptPages)
+        page->release();
+    keptPages.clear();
+}
+
+InputCache::InputCache(const uint32 capacity) : m_capacity(capacity), m_nextId(0), m_reuseCount(0)
+{
+}
+
+uint32 InputCache::getReuseCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_reuseCount;
+}
+
+// Find an entry by path and password, making it the most recently used
+bool InputCache::findLocked(const std::string& key, std::shared_future<OpenedInputPtr>& opened)
+{
+    const auto found = m_byKey.find(key);
+    if (found == m_byKey.end())
+        return false;
+
+    m_entries.splice(m_entries.begin(), m_entries, found->second);
+    opened = found->second->opened;
+    m_reuseCount++;
+    return true;
+}
+
+void InputCache::removeLocked(const EntryList::iterator entry)
+{
+    for (const auto& key : entry->keys)
+        m_byKey.erase(key);
+    m_entries.erase(entry);
+}
+
+// Release the pages kept for the inputs the cache has let go of. An input still being opened is waited for, so that
+// its pages are not kept. Called without the lock held, as it takes the lock of each input.
+void InputCache::releaseEvicted(const std::vector<std::shared_future<OpenedInputPtr>>& evicted)
+{
+    for (const auto& opened : evicted)
+    {
+        try
+        {
+            opened.get()->releaseKeptPages();
+        }
+        catch (...)
+        {
+            // The input could not be opened, so has no pages; the error is reported where it was opened
+        }
+    }
+}
+
+OpenedInputPtr InputCache::open(const String& path, const U8String& password, const OpenFunc& openFunc, bool& reused)
+{
+    reused = false;
+    if (!m_capacity)
+    {
+        OpenedInputPtr opened = std::make_shared<sOpenedInput>();
+        openFunc(*opened);
+        return opened;
+    }
+
+    const std::string key = std::string(StringToU8String(path).c_str()) + '\n' + password.c_str();
+    std::shared_future<OpenedInputPtr> found;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        reused = findLocked(key, found);
+    }
+    if (reused)
+        return found.get();
+
+    // Look for another file with the same content, hashing this file, and any of the same size, outside the lock
+    uint64 bytes = 0;
+    const bool sized = fileSize(path, bytes);
+    std::vector<std::pair<std::string, String>> unhashed;
+    bool sameSize = false;
+    if (sized)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto& entry : m_entries)
+        {
+            if (entry.bytes != bytes || entry.password != password)
+                continue;
+            sameSize = true;
+            if (!entry.hashed)
+                unhashed.push_back({ entry.keys[0], entry.path });
+        }
+    }
+
+    uint64 hash = 0;
+    const bool hashed = sameSize && hashFile(path, hash);
+    std::vector<std::pair<std::string, uint64>> hashes;
+    for (const auto& other : unhashed)
+    {
+        uint64 otherHash;
+        if (hashed && hashFile(other.second, otherHash))
+            hashes.push_back({ other.first, otherHash });
+    }
+
+    std::promise<OpenedInputPtr> promise;
+    uint64 id = 0;
+    std::vector<std::shared_future<OpenedInputPtr>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Another thread may have opened the same file meanwhile
+        reused = findLocked(key, found);
+        if (!reused && hashed)
+        {
+            for (const auto& other : hashes)
+            {
+                const auto entry = m_byKey.find(other.first);
+                if (entry != m_byKey.end())
+                {
+                    entry->second->hash = other.second;
+                    entry->second->hashed = true;
+                }
+            }
+            for (auto entry = m_entries.begin(); entry != m_entries.end(); ++entry)
+            {
+                if (entry->hashed && entry->bytes == bytes && entry->hash == hash && entry->password == password)
+                {
+                    entry->keys.push_back(key);
+                    m_byKey[key] = entry;
+                    reused = findLocked(key, found);
+                    break;
+                }
+            }
+        }
+
+        if (!reused)
+        {
+            id = m_nextId++;
+            m_entries.push_front({ id, { key }, path, password, sized ? bytes : 0, hash, hashed, promise.get_future().share() });
+            m_byKey[key] = m_entries.begin();
+            while (m_entries.size() > m_capacity)
+            {
+                evicted.push_back(m_entries.back().opened);
+                removeLocked(std::prev(m_entries.end()));
+            }
+        }
+    }
+    releaseEvicted(evicted);
+    if (reused)
+        return found.get();
+
+    // Open the input, passing it, or the error opening it, to any other thread waiting for it
+    OpenedInputPtr opened = std::make_shared<sOpenedInput>();
+    try
+    {
+        openFunc(*opened);
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+
+        // Let a later occurrence try again, rather than fail with this error
+        std::lock_guard<std::mutex> lock(m_mutex);
+        const auto entry = m_byKey.find(key);
+        if (entry != m_byKey.end() && entry->second->id == id)
+            removeLocked(entry->second);
+        throw;
+    }
+    promise.set_value(opened);
+    return opened;
+}
@@ -0,0 +1,98 @@
+// -----------------------------------------------------------------------
+//  <copyright file="InputCache.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BookmarkOutline.h"
+#include "PageIdIndex.h"
+
+using namespace EDL;
+using namespace JawsMako;
+
+// An input that has been opened, with everything taken from it besides its pages.
+// It is shared by every occurrence of the input in the list of inputs.
+struct sOpenedInput
+{
+    IDocumentPtr document;
+    PageIdIndex sourcePages;                    // Every page of the document, so pages are only looked up once
+    BookmarkOutline bookmarks;                  // Each range takes its share when it is appended
+    CNamedDestinationVect namedDestinations;
+    IOptionalContentPtr optionalContent;
+    IFormPtr form;                              // The form fields, whose widgets are on the pages
+    std::mutex mutex;                           // Held while the pages are used, as occurrences are prepared and appended on different threads
+    std::vector<IPagePtr> keptPages;            // The pages appended for the first occurrence, kept while the input may be reused
+    bool evicted = false;                       // Set once the cache has let go of the input, after which no pages are kept
+
+    // Keep a page that has been appended, so that its copies for later occurrences share its resources, or release it
+    // if the input can no longer be reused. Called with the mutex held.
+    void keepPage(const IPagePtr& page);
+
+    // Release the kept pages, as the cache has let go of the input
+    void releaseKeptPages();
+};
+
+typedef std::shared_ptr<sOpenedInput> OpenedInputPtr;
+
+// The inputs opened most recently, so that an input that appears many times, such as terms and conditions that
+// follow every statement, is opened and parsed once however many times it is combined. An input is matched by its
+// path and password, or by its content, should another file of the same size have the same hash. Files are only
+// hashed when their size matches, so inputs that are all different are not read an extra time.
+class InputCache
+{
+public:
+    typedef std::function<void(sOpenedInput& opened)> OpenFunc;
+
+    // Keeps up to capacity inputs, letting go of the one used least recently first. Zero keeps none.
+    explicit InputCache(uint32 capacity);
+
+    // The input, opened with the function unless it is already open, or being opened by another thread.
+    // reused is set if it was opened for an earlier occurrence. May be called from any thread.
+    OpenedInputPtr open(const String& path, const U8String& password, const OpenFunc& openFunc, bool& reused);
+
+    // The number of occurrences that used an input already open
+    uint32 getReuseCount() const;
+
+private:
+    struct sEntry
+    {
+        uint64 id;
+        std::vector<std::string> keys;          // The path and password of each file found to have this content
+        String path;
+        U8String password;
+        uint64 bytes;
+        uint64 hash;
+        bool hashed;
+        std::shared_future<OpenedInputPtr> opened;
+    };
+
+    typedef std::list<sEntry> EntryList;
+
+    bool findLocked(const std::string& key, std::shared_future<OpenedInputPtr>& opened);
+    void removeLocked(EntryList::iterator entry);
+    static void releaseEvicted(const std::vector<std::shared_future<OpenedInputPtr>>& evicted);
+
+    uint32 m_capacity;
+    mutable std::mutex m_mutex;
+    EntryList m_entries;                        // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> m_byKey;
+    uint64 m_nextId;
+    uint32 m_reuseCount;
+};
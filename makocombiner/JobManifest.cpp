@@ -0,0 +1,265 @@
+// -----------------------------------------------------------------------
+//  <copyright file="JobManifest.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "JobManifest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+
+static String toString(const std::string& utf8)
+{
+    return U8StringToString(U8String(utf8.c_str()));
+}
+
+static void appendUTF8(std::string& text, const uint32 codePoint)
+{
+    if (codePoint < 0x80)
+        text += (char)codePoint;
+    else if (codePoint < 0x800)
+    {
+        text += (char)(0xC0 | (codePoint >> 6));
+        text += (char)(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        text += (char)(0xE0 | (codePoint >> 12));
+        text += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        text += (char)(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        text += (char)(0xF0 | (codePoint >> 18));
+        text += (char)(0x80 | ((codePoint >> 12) & 0x3F));
+        text += (char)(0x80 | ((codePoint >> 6) & 0x3F));
+        text += (char)(0x80 | (codePoint & 0x3F));
+    }
+}
+
+bool JobManifest::isManifest(const String& extension)
+{
+    return extension == L".txt" || extension == L".csv" || extension == L".jsonl";
+}
+
+JobManifest::JobManifest(const String& path, const String& extension) :
+    m_path(path), m_format(extension == L".csv" ? eCSV : extension == L".jsonl" ? eJSONLines : eList), m_lineNumber(0), m_entryRead(false)
+{
+#ifdef _WIN32
+    m_file = _wfopen(path.c_str(), L"rb");
+#else
+    m_file = fopen(StringToU8String(path).c_str(), "rb");
+#endif
+    if (!m_file)
+    {
+        std::string message("Unable to open file list ");
+        message += StringToU8String(path).c_str();
+        throw std::runtime_error(message);
+    }
+}
+
+JobManifest::~JobManifest()
+{
+    fclose(m_file);
+}
+
+bool JobManifest::readLine(std::string& line)
+{
+    line.clear();
+    int c;
+    while ((c = getc(m_file)) != EOF && c != '\n')
+        line += (char)c;
+    if (c == EOF && line.empty())
+        return false;
+
+    if (!line.empty() && line.back() == '\r')
+        line.pop_back();
+    if (m_lineNumber++ == 0 && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+        line.erase(0, 3);
+    return true;
+}
+
+bool JobManifest::next(sEntry& entry)
+{
+    std::string line;
+    while (readLine(line))
+    {
+        const bool firstEntry = !m_entryRead;
+        const size_t start = line.find_first_not_of(" \t");
+        if (start == std::string::npos || line[start] == '#')
+            continue;
+
+        entry = sEntry();
+        if (m_format == eList)
+            entry.path = toString(line);
+        else if (m_format == eCSV)
+        {
+            parseCSV(line, entry);
+
+            // Skip a header, on the first line that is not blank or a comment
+            m_entryRead = true;
+            if (firstEntry && entry.path == L"path")
+                continue;
+        }
+        else
+            parseJSON(line, entry);
+
+        if (entry.path.empty())
+            fail("no path");
+        m_entryRead = true;
+        return true;
+    }
+    return false;
+}
+
+void JobManifest::parseCSV(const std::string& line, sEntry& entry) const
+{
+    std::vector<std::string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++)
+    {
+        const char c = line[i];
+        if (quoted)
+        {
+            if (c != '"')
+                fields.back() += c;
+            else if (i + 1 < line.size() && line[i + 1] == '"')
+                fields.back() += line[++i];
+            else
+                quoted = false;
+        }
+        else if (c == '"')
+            quoted = true;
+        else if (c == ',')
+            fields.push_back(std::string());
+        else
+            fields.back() += c;
+    }
+    if (quoted)
+        fail("unterminated quote");
+    if (fields.size() > 4)
+        fail("too many fields");
+
+    entry.path = toString(fields[0]);
+    if (fields.size() > 1)
+        entry.ranges = toString(fields[1]);
+    if (fields.size() > 2)
+        entry.password = fields[2].c_str();
+    if (fields.size() > 3)
+        entry.label = toString(fields[3]);
+}
+
+// Parse a JSON object whose values are strings (or null). Names other than those of an entry are ignored.
+void JobManifest::parseJSON(const std::string& line, sEntry& entry) const
+{
+    size_t pos = 0;
+    const auto skipSpace = [&]()
+    {
+        while (pos < line.size() && (line[pos] == ' ' || line[pos] == '\t'))
+            pos++;
+    };
+    const auto expect = [&](const char c)
+    {
+        skipSpace();
+        if (pos >= line.size() || line[pos] != c)
+            fail("malformed JSON");
+        pos++;
+    };
+    const auto parseString = [&]()
+    {
+        expect('"');
+        std::string text;
+        while (pos < line.size() && line[pos] != '"')
+        {
+            char c = line[pos++];
+            if (c != '\\')
+            {
+                text += c;
+                continue;
+            }
+            if (pos >= line.size())
+                break;
+            c = line[pos++];
+            switch (c)
+            {
+            case 'b': text += '\b'; break;
+            case 'f': text += '\f'; break;
+            case 'n': text += '\n'; break;
+            case 'r': text += '\r'; break;
+            case 't': text += '\t'; break;
+            case 'u':
+            {
+                const auto hex4 = [&]()
+                {
+                    if (pos + 4 > line.size() || !std::all_of(line.begin() + pos, line.begin() + pos + 4, [](const char c) { return isxdigit((unsigned char)c) != 0; }))
+                        fail("malformed JSON");
+                    const uint32 value = (uint32)std::stoul(line.substr(pos, 4), nullptr, 16);
+                    pos += 4;
+                    return value;
+                };
+                uint32 codePoint = hex4();
+                if (codePoint >= 0xD800 && codePoint < 0xDC00 && line.compare(pos, 2, "\\u") == 0)
+                {
+                    pos += 2;
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (hex4() - 0xDC00);
+                }
+                appendUTF8(text, codePoint);
+                break;
+            }
+            default: text += c; break;
+            }
+        }
+        expect('"');
+        return text;
+    };
+
+    expect('{');
+    skipSpace();
+    if (pos < line.size() && line[pos] == '}')
+        fail("no path");
+
+    for (;;)
+    {
+        const std::string name = parseString();
+        expect(':');
+        skipSpace();
+        std::string value;
+        if (line.compare(pos, 4, "null") == 0)
+            pos += 4;
+        else
+            value = parseString();
+
+        if (name == "path")
+            entry.path = toString(value);
+        else if (name == "ranges")
+            entry.ranges = toString(value);
+        else if (name == "password")
+            entry.password = value.c_str();
+        else if (name == "label")
+            entry.label = toString(value);
+
+        skipSpace();
+        if (pos < line.size() && line[pos] == ',')
+        {
+            pos++;
+            continue;
+        }
+        expect('}');
+        break;
+    }
+}
+
+void JobManifest::fail(const char* problem) const
+{
+    std::string message = StringToU8String(m_path).c_str();
+    message += " line " + std::to_string(m_lineNumber) + ": " + problem;
+    throw std::invalid_argument(message);
+}
@@ -0,0 +1,65 @@
+// -----------------------------------------------------------------------
+//  <copyright file="JobManifest.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <cstdio>
+#include <string>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// A list of the files to combine, read an entry at a time, so that combining can start straight away
+// however long the list is. The format is chosen by the extension of the file, and is UTF-8 throughout:
+//   .txt    One path to a line
+//   .csv    path[,ranges[,password[,label]]] to a line. Fields may be quoted, with "" for a quote.
+//           A first entry whose path is the field name path is taken to be a header.
+//   .jsonl  One object to a line, eg {"path": "a.pdf", "ranges": "1-3;7", "password": "x", "label": "Invoice 1"}
+// Blank lines, and lines starting with #, are skipped.
+class JobManifest
+{
+public:
+    struct sEntry
+    {
+        String path;
+        String ranges;          // As after the / of a file on the command line, eg 10-20;80;90-
+        U8String password;
+        String label;           // For the bookmark of the file, in place of its name
+    };
+
+    static bool isManifest(const String& extension);
+
+    JobManifest(const String& path, const String& extension);
+    ~JobManifest();
+
+    // Read the next entry; false at the end of the list
+    bool next(sEntry& entry);
+
+private:
+    enum eFormat
+    {
+        eList,
+        eCSV,
+        eJSONLines
+    };
+
+    bool readLine(std::string& line);
+    void parseCSV(const std::string& line, sEntry& entry) const;
+    void parseJSON(const std::string& line, sEntry& entry) const;
+    [[noreturn]] void fail(const char* problem) const;
+
+    String m_path;
+    eFormat m_format;
+    FILE* m_file;
+    uint32 m_lineNumber;
+    bool m_entryRead;       // A line other than a blank or comment has been read, so a header would have been seen
+};
@@ -28,18 +28,72 @@ bool findGroupReference(const COptionalContentGroupVect& optionalContentGroups,
 }
 
 // Constructor
-Layers::Layers(const IJawsMakoPtr& mako) : m_mako(mako)
+Layers::Layers(const IJawsMakoPtr& mako, const bool mergeByName) : m_mako(mako), m_mergeByName(mergeByName)
 {
     m_newOptionalContent = IOptionalContent::create(m_mako);
     m_newConfiguration = m_newOptionalContent->getDefaultConfiguration();
     m_newOrderEntryVect = m_newConfiguration->getOrder();
 }
 
+// Keep the OCGs of the document being added to, and add to its order rather than starting afresh
+void Layers::appendExisting(const IOptionalContentPtr& optionalContent)
+{
+    if (!optionalContent)
+        return;
+
+    m_newOptionalContent = optionalContent;
+    m_newConfiguration = m_newOptionalContent->getDefaultConfiguration();
+    m_newOrderEntryVect = m_newConfiguration->getOrder();
+
+    // Groups added later with the same names are merged into these
+    if (m_mergeByName)
+    {
+        COptionalContentGroupVect groups = optionalContent->getGroups();
+        for (uint32 groupIndex = 0; groupIndex < groups.size(); groupIndex++)
+            m_groupsByName.emplace(groups[groupIndex]->getName().c_str(), groups[groupIndex]->getReference());
+    }
+}
+
 // Get the OCGs from the PDF
 bool Layers::AppendDocumentLayers(const IDocumentPtr& sourceDocument, const U8String name)
 {
+    return AppendDocumentLayers(sourceDocument, sourceDocument->getOptionalContent(), name);
+}
+
+// Append the OCGs of a PDF, where its optional content has been fetched in advance
+bool Layers::AppendDocumentLayers(const IDocumentPtr& sourceDocument, const IOptionalContentPtr& optionalContent, const U8String name)
+{
+    m_mergedGroups.clear();
+    m_sourceOptionalContent = IOptionalContentPtr();
+
+    // Merge the groups into those of the same name, adding only those with new names. The order becomes a flat
+    // list of every group, so the layers panel lists each name once, whatever the number of documents.
+    if (optionalContent && m_mergeByName)
+    {
+        m_sourceOptionalContent = optionalContent;
+        COptionalContentGroupVect groups = optionalContent->getGroups();
+        for (uint32 groupIndex = 0; groupIndex < groups.size(); groupIndex++)
+        {
+            const IOptionalContentGroupReferencePtr groupReference = groups[groupIndex]->getReference();
+            const auto found = m_groupsByName.emplace(groups[groupIndex]->getName().c_str(), groupReference);
+            if (!found.second)
+            {
+                m_mergedGroups.emplace(found.first->first, found.first->second);
+                continue;
+            }
+
+            m_newOptionalContent->addGroup(groups[groupIndex]->clone(), sourceDocument);
+            IOptionalContentConfiguration::COrderEntryPtr newOrderEntry = IOptionalContentConfiguration::COrderEntry::create();
+            newOrderEntry->isGroup = true;
+            newOrderEntry->groupRef = groupReference;
+            m_newOrderEntryVect.append(newOrderEntry);
+        }
+        m_newConfiguration->setOrder(m_newOrderEntryVect);
+        m_newConfiguration->setListMode(IOptionalContentConfiguration::eLMAllPages);
+        return true;
+    }
+
     // Is there optional content in the source document?
-    const IOptionalContentPtr optionalContent = sourceDocument->getOptionalContent();
     if (optionalContent)
     {
         // Copy over the groups
@@ -124,6 +178,66 @@ bool Layers::AppendDocumentLayers(const IDocumentPtr& sourceDocument, const U8St
     return true;
 }
 
+// Append the OCGs of a document combined earlier, whose order already lists the layers of each of its inputs
+bool Layers::AppendCombinedLayers(const IDocumentPtr& sourceDocument, const IOptionalContentPtr& optionalContent)
+{
+    // Merged layers are a flat list of names, which carries on from one combined document to the next
+    if (m_mergeByName)
+        return AppendDocumentLayers(sourceDocument, optionalContent, U8String());
+
+    m_mergedGroups.clear();
+    m_sourceOptionalContent = IOptionalContentPtr();
+    if (optionalContent)
+    {
+        COptionalContentGroupVect groups = optionalContent->getGroups();
+        for (uint32 groupIndex = 0; groupIndex < groups.size(); groupIndex++)
+        {
+            m_newOptionalContent->addGroup(groups[groupIndex]->clone(), sourceDocument);
+        }
+
+        const IOptionalContentConfiguration::COrderEntryVect order = optionalContent->getDefaultConfiguration()->getOrder();
+        for (uint32 orderIndex = 0; orderIndex < order.size(); orderIndex++)
+            m_newOrderEntryVect.append(order[orderIndex]);
+        m_newConfiguration->setOrder(m_newOrderEntryVect);
+        m_newConfiguration->setListMode(IOptionalContentConfiguration::eLMAllPages);
+    }
+    return true;
+}
+
+// Replace references to groups that were merged into another, finding each by the name of the group it refers to
+bool Layers::remapNode(void* priv, const IDOMNodePtr& node)
+{
+    const Layers* layers = static_cast<const Layers*>(priv);
+
+    const IOptionalContentDetailsPtr details = node->getOptionalContentDetails();
+    if (!details)
+        return true;
+
+    COptionalContentGroupReferenceVect groupReferences = details->getGroupRefs();
+    bool remapped = false;
+    for (uint32 i = 0; i < groupReferences.size(); i++)
+    {
+        const IOptionalContentGroupPtr group = layers->m_sourceOptionalContent->getGroup(groupReferences[i]);
+        if (!group)
+            continue;
+
+        // A group with a name that was merged may be the one the others were merged into
+        const auto merged = layers->m_mergedGroups.find(group->getName().c_str());
+        if (merged == layers->m_mergedGroups.end() || merged->second->equals(groupReferences[i]))
+            continue;
+        groupReferences[i] = merged->second;
+        remapped = true;
+    }
+    if (remapped)
+        details->setGroupRefs(groupReferences);
+    return true;
+}
+
+void Layers::remapContent(const IDOMFixedPagePtr& content) const
+{
+    content->walkTree(remapNode, (void*)this, true, true);
+}
+
 // Return layers
 IOptionalContentPtr Layers::getLayers()
 {
@@ -12,18 +12,49 @@
 #pragma once
 #include <jawsmako/jawsmako.h>
 
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
 using namespace JawsMako;
 
 class Layers
 {
 public:
-    Layers(const IJawsMakoPtr& mako);
+    // With mergeByName, groups with the same name in several documents become the one group, which toggles them all
+    Layers(const IJawsMakoPtr& mako, bool mergeByName = false);
+
+    // Start from the layers of a document that is being added to, so that they are kept
+    void appendExisting(const IOptionalContentPtr& optionalContent);
     bool AppendDocumentLayers(const IDocumentPtr& sourceDocument, U8String name);
+    bool AppendDocumentLayers(const IDocumentPtr& sourceDocument, const IOptionalContentPtr& optionalContent, U8String name);
+
+    // Append the OCGs of a document that was itself combined, keeping its order as it is rather than listing
+    // it under another name, so that combining in parts gives the same layers as combining in one go
+    bool AppendCombinedLayers(const IDocumentPtr& sourceDocument, const IOptionalContentPtr& optionalContent);
     IOptionalContentPtr getLayers();
 
+    // True if the content of the document last appended must be pointed at groups it was merged into
+    bool hasContentToRemap() const
+    {
+        return !m_mergedGroups.empty();
+    }
+
+    // Point the optional content on a page of the document last appended at the groups it was merged into
+    void remapContent(const IDOMFixedPagePtr& content) const;
+
 private:
+    static bool remapNode(void* priv, const IDOMNodePtr& node);
+
     IJawsMakoPtr m_mako;
     IOptionalContentPtr m_newOptionalContent;
     IOptionalContentConfigurationPtr m_newConfiguration;
     IOptionalContentConfiguration::COrderEntryVect m_newOrderEntryVect;
+    bool m_mergeByName;
+    std::unordered_map<std::string, IOptionalContentGroupReferencePtr> m_groupsByName;
+    IOptionalContentPtr m_sourceOptionalContent;    // The optional content of the document last appended, when merged
+
+    // For the document last appended, the group each name was merged into, for the groups that were merged
+    std::unordered_map<std::string, IOptionalContentGroupReferencePtr> m_mergedGroups;
 };
\ No newline at end of file
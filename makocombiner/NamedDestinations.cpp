@@ -19,79 +19,83 @@ NamedDestinations::NamedDestinations(const IJawsMakoPtr& mako) : m_mako(mako)
 // Records all named destinations in the given document
 void NamedDestinations::appendAll(const IDocumentPtr& document)
 {
-    CNamedDestinationVect namedDestinations = document->getNamedDestinations();
+    appendAll(document->getNamedDestinations());
+}
+
+// Records all named destinations in a list, eg one fetched from a document in advance. They come before any input.
+void NamedDestinations::appendAll(const CNamedDestinationVect& namedDestinations)
+{
     if (!namedDestinations.empty())
     {
         for (uint32 i = 0; i < namedDestinations.size(); i++)
         {
-            append(namedDestinations[i]);
+            append(namedDestinations[i], 0);
         }
     }
 }
 
-// Records named destinations in the given document that refer to pages within the specified range
-void NamedDestinations::appendRange(const IDocumentPtr& document, uint32 firstPage, uint32 lastPage)
+// Records the named destinations in a list that refer to pages copied to the output, retargeted to the copies.
+// The source pages are looked up in the index of the source document.
+void NamedDestinations::appendCopied(const CNamedDestinationVect& namedDestinations, const PageIdIndex& sourcePages, const CopiedPageIdFunc& copiedPageId,
+    const uint32 inputIndex, const DestinationInputs* destinationInputs)
 {
-    // Reset the list
-    m_destinations.clear();
-
-    // Create list of pageIds to compare against
-    CEDLVector<DOMid> pageIds;
-    for (uint32 pageIndex = firstPage - 1; pageIndex < lastPage; pageIndex++)
+    for (uint32 i = 0; i < namedDestinations.size(); i++)
     {
-        pageIds.append(document->getPage(pageIndex)->getPageId());
-    }
+        IDOMPageRectTargetPtr target = namedDestinations[i]->getTarget();
+        uint32 sourcePageIndex;
+        DOMid targetPageId;
+        if (!target || !sourcePages.findPageIndex(target->getPageId(), sourcePageIndex) || !copiedPageId(sourcePageIndex, targetPageId))
+            continue;
 
-    // Process the named destinations
-    CNamedDestinationVect namedDestinations = document->getNamedDestinations();
-    if (!namedDestinations.empty())
-    {
-        for (uint32 i = 0; i < namedDestinations.size(); i++)
+        uint32 destinationInput = inputIndex;
+        if (destinationInputs)
         {
-            IDOMPageRectTargetPtr target = namedDestinations[i]->getTarget();
-            if (target) {
-                try
-                {
-                    uint32 found = pageIds.indexOf(target->getPageId());
+            const auto found = destinationInputs->find(namedDestinations[i]->getName().c_str());
+            if (found != destinationInputs->end())
+                destinationInput = found->second;
+        }
 
-                    // There is a matching page, add it to the list
-                    append(namedDestinations[i]);
-                }
-                catch (IError &e)
-                {
-                }
-            }
+        if (targetPageId == target->getPageId())
+            append(namedDestinations[i], destinationInput);
+        else
+        {
+            target = IDOMPageRectTarget::create(m_mako, targetPageId, target->getFitType(), target->getZoom(), target->getLeft(), target->getTop(), target->getRight(), target->getBottom());
+            append(INamedDestination::create(m_mako, namedDestinations[i]->getName(), target), destinationInput);
         }
     }
 }
 
-// Appends a named destination avoiding name clashes
-void NamedDestinations::append(const INamedDestinationPtr& namedDestination)
+// Appends a named destination avoiding name clashes. A name already taken is qualified with the position of the
+// input it came from, and if need be a count as well, so the result is unique and the same from run to run.
+void NamedDestinations::append(const INamedDestinationPtr& namedDestination, const uint32 inputIndex)
 {
-    U8String name = namedDestination->getName();
-    try
+    const U8String name = namedDestination->getName();
+    if (m_names.insert(name.c_str()).second)
     {
-        uint32 found = m_names.indexOf(name);
-
-        // name already taken
-        U8String suffix = ".  ";
-        suffix[1] = suffixChars[rand() % 63];
-        suffix[2] = suffixChars[rand() % 63];
-        name += suffix;
-        const INamedDestinationPtr renamedNamedDestination = INamedDestination::create(m_mako, name, namedDestination->getTarget());
-        m_destinations.append(renamedNamedDestination);
-        m_names.append(name);
-    }
-    catch(IError &e)
-    {
-        // name not found in list
         m_destinations.append(namedDestination);
-        m_names.append(name);
+        m_inputs[name.c_str()] = inputIndex;
+        return;
     }
+
+    // name already taken
+    const std::string qualifiedName = std::string(name.c_str()) + "." + std::to_string(inputIndex);
+    std::string uniqueName = qualifiedName;
+    for (uint32 count = 2; !m_names.insert(uniqueName).second; count++)
+        uniqueName = qualifiedName + "." + std::to_string(count);
+
+    const INamedDestinationPtr renamedNamedDestination = INamedDestination::create(m_mako, U8String(uniqueName.c_str()), namedDestination->getTarget());
+    m_destinations.append(renamedNamedDestination);
+    m_inputs[uniqueName] = inputIndex;
 }
 
 // Return named destinations
 CNamedDestinationVect NamedDestinations::getList() const
 {
     return m_destinations;
+}
+
+// Return the input each named destination came from
+const DestinationInputs& NamedDestinations::getInputs() const
+{
+    return m_inputs;
 }
\ No newline at end of file
@@ -12,20 +12,40 @@
 #pragma once
 #include <jawsmako/jawsmako.h>
 
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "PageIdIndex.h"
+
 using namespace JawsMako;
 
+// Gives the id of the copy in the output of a page of the source, by its index, or false if it was not copied
+typedef std::function<bool(uint32 sourcePageIndex, DOMid& targetPageId)> CopiedPageIdFunc;
+
+// The position of the input that each named destination came from, by name, so that a part combined earlier
+// can have its names made unique as they would have been had its inputs been combined in one go
+typedef std::unordered_map<std::string, uint32> DestinationInputs;
+
 class NamedDestinations
 {
 public:
     NamedDestinations(const IJawsMakoPtr& jawsMako);
     void appendAll(const IDocumentPtr& document);
-    void appendRange(const IDocumentPtr& document, uint32 startPageIndex, uint32 endPageIndex);
+    void appendAll(const CNamedDestinationVect& namedDestinations);
+
+    // A name already taken is qualified with the position of the input it came from: that of the name in
+    // destinationInputs, if given and the name is there, or else inputIndex.
+    void appendCopied(const CNamedDestinationVect& namedDestinations, const PageIdIndex& sourcePages, const CopiedPageIdFunc& copiedPageId,
+        uint32 inputIndex, const DestinationInputs* destinationInputs = nullptr);
     CNamedDestinationVect getList() const;
+    const DestinationInputs& getInputs() const;
 
 private:
-    void append(const INamedDestinationPtr& namedDestination);
+    void append(const INamedDestinationPtr& namedDestination, uint32 inputIndex);
     IJawsMakoPtr m_mako;
     CNamedDestinationVect m_destinations;
-    CEDLSysStringVect m_names;
-    const U8String suffixChars = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcdefghijklmnopqrstuvwxyz";
+    std::unordered_set<std::string> m_names;
+    DestinationInputs m_inputs;
 };
\ No newline at end of file
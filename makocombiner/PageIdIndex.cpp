@@ -0,0 +1,41 @@
+// -----------------------------------------------------------------------
+//  <copyright file="PageIdIndex.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "PageIdIndex.h"
+
+PageIdIndex::PageIdIndex(const IDocumentPtr& document)
+{
+    const uint32 pageCount = document->getNumPages();
+    m_pageIds.reserve(pageCount);
+    m_pageIndices.reserve(pageCount);
+    for (uint32 i = 0; i < pageCount; i++)
+    {
+        IPagePtr page = document->getPage(i);
+        append(page->getPageId());
+        page->release();
+    }
+}
+
+void PageIdIndex::append(const DOMid pageId)
+{
+    m_pageIndices.emplace(pageId, (uint32)m_pageIds.size());
+    m_pageIds.push_back(pageId);
+}
+
+bool PageIdIndex::findPageIndex(const DOMid pageId, uint32& pageIndex) const
+{
+    const auto found = m_pageIndices.find(pageId);
+    if (found == m_pageIndices.end())
+        return false;
+
+    pageIndex = found->second;
+    return true;
+}
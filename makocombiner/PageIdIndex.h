@@ -0,0 +1,53 @@
+// -----------------------------------------------------------------------
+//  <copyright file="PageIdIndex.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <unordered_map>
+#include <vector>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// The ids of the pages of a document, by index, and the index of each page, by id.
+// Bookmarks and named destinations refer to pages by id, so copying them means looking up pages
+// both ways; building this once per document saves fetching the pages again for every lookup.
+class PageIdIndex
+{
+public:
+    PageIdIndex()
+    {
+    }
+
+    // Index the pages of a document, fetching each page once
+    explicit PageIdIndex(const IDocumentPtr& document);
+
+    // Add the next page, eg as a page is appended to the output
+    void append(DOMid pageId);
+
+    uint32 getCount() const
+    {
+        return (uint32)m_pageIds.size();
+    }
+
+    DOMid getPageId(const uint32 pageIndex) const
+    {
+        return m_pageIds[pageIndex];
+    }
+
+    // Find the index of a page from its id. Should a page appear more than once, its first index is given.
+    bool findPageIndex(DOMid pageId, uint32& pageIndex) const;
+
+private:
+    std::vector<DOMid> m_pageIds;
+    std::unordered_map<DOMid, uint32> m_pageIndices;
+};
@@ -0,0 +1,178 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ResourceDeduplicator.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "ResourceDeduplicator.h"
+
+#include <typeinfo>
+#include <vector>
+
+// The number of objects of each kind remembered as seen
+static const size_t maxSeen = 4096;
+
+void ResourceDeduplicator::share(const IDOMFixedPagePtr& content)
+{
+    content->walkTree(shareResources, this, true, true);
+}
+
+uint32 ResourceDeduplicator::getSharedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_images.sharedCount + m_fonts.sharedCount;
+}
+
+uint64 ResourceDeduplicator::getBytesSaved() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_images.bytesSaved + m_fonts.bytesSaved;
+}
+
+// Replace the image painted by a path, or the font of some text
+bool ResourceDeduplicator::shareResources(void* priv, const IDOMNodePtr& node)
+{
+    ResourceDeduplicator* deduplicator = static_cast<ResourceDeduplicator*>(priv);
+
+    const IDOMGlyphsPtr glyphs = edlobj2IDOMGlyphs(node);
+    if (glyphs)
+    {
+        const IDOMFontPtr font = glyphs->getFont();
+        if (font)
+        {
+            const IDOMFontPtr sharedFont = deduplicator->share(deduplicator->m_fonts, font);
+            if (sharedFont != font)
+                glyphs->setFont(sharedFont);
+        }
+        return true;
+    }
+
+    const IDOMPathNodePtr path = edlobj2IDOMPathNode(node);
+    if (!path)
+        return true;
+
+    const IDOMImageBrushPtr imageBrush = edlobj2IDOMImageBrush(path->getFill());
+    if (!imageBrush)
+        return true;
+
+    const IDOMImagePtr image = imageBrush->getImageSource();
+    if (image)
+    {
+        const IDOMImagePtr sharedImage = deduplicator->share(deduplicator->m_images, image);
+        if (sharedImage != image)
+            imageBrush->setImageSource(sharedImage);
+    }
+    return true;
+}
+
+// Find what an object seen recently is replaced with, making it the most recently seen. Called with the lock held.
+template <typename T>
+bool ResourceDeduplicator::findSeen(sResources<T>& resources, const void* object, T& shared)
+{
+    const auto found = resources.seenByObject.find(object);
+    if (found == resources.seenByObject.end())
+        return false;
+
+    resources.seen.splice(resources.seen.begin(), resources.seen, found->second);
+    shared = found->second->shared;
+    return true;
+}
+
+// Find the resource to use in place of the given one; the first identical one seen, or itself if it is the first
+template <typename T>
+T ResourceDeduplicator::share(sResources<T>& resources, const T& resource)
+{
+    const void* object = &*resource;
+    T shared;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (findSeen(resources, object, shared))
+            return shared;
+    }
+
+    // Reading the data is the costly part, so it is done without holding the lock
+    sFingerprint resourceFingerprint;
+    if (!describe(resource, resourceFingerprint) || !fingerprintStream(resource->getStream(), resourceFingerprint))
+        return resource;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (findSeen(resources, object, shared))
+        return shared;                  // Another thread got there first
+
+    const auto found = resources.byFingerprint.emplace(resourceFingerprint, resource);
+    if (!found.second)
+    {
+        resources.sharedCount++;
+        resources.bytesSaved += resourceFingerprint.bytes;
+    }
+    resources.seen.push_front({ object, resource, found.first->second });
+    resources.seenByObject[object] = resources.seen.begin();
+    while (resources.seen.size() > maxSeen)
+    {
+        resources.seenByObject.erase(resources.seen.back().object);
+        resources.seen.pop_back();
+    }
+    return found.first->second;
+}
+
+// The kind of an image, and what it decodes to. Only the first row is decoded.
+bool ResourceDeduplicator::describe(const IDOMImagePtr& image, sFingerprint& fingerprint) const
+{
+    const IImageFramePtr frame = image->getImageFrame(m_mako);
+    if (!frame)
+        return false;
+
+    fingerprint = sFingerprint();
+    fingerprint.type = typeid(*image).hash_code();
+    fingerprint.width = frame->getWidth();
+    fingerprint.height = frame->getHeight();
+    fingerprint.bpc = frame->getBPC();
+    fingerprint.channels = frame->getNumChannels();
+    const IDOMColorSpacePtr colorSpace = frame->getColorSpace();
+    fingerprint.colorSpace = colorSpace ? (int32)colorSpace->getColorSpaceType() : -1;
+
+    std::vector<uint8> row(frame->getRawBytesPerRow());
+    frame->readScanLine(row.data(), (uint32)row.size());
+    fingerprint.firstRow = 0xCBF29CE484222325ULL;
+    for (const uint8 byte : row)
+        fingerprint.firstRow = (fingerprint.firstRow ^ byte) * 0x100000001B3ULL;
+    return true;
+}
+
+// The kind of a font
+bool ResourceDeduplicator::describe(const IDOMFontPtr& font, sFingerprint& fingerprint) const
+{
+    fingerprint = sFingerprint();
+    fingerprint.type = typeid(*font).hash_code();
+    return true;
+}
+
+// Size and hashes of a resource's data; 64-bit FNV-1a, checked with a 64-bit multiply-xorshift hash
+bool ResourceDeduplicator::fingerprintStream(const IRAInputStreamPtr& stream, sFingerprint& fingerprint)
+{
+    if (!stream || !stream->open())
+        return false;
+
+    std::vector<uint8> buffer(64 * 1024);
+    fingerprint.bytes = 0;
+    fingerprint.hash = 0xCBF29CE484222325ULL;
+    fingerprint.check = 0x9E3779B97F4A7C15ULL;
+    int32 bytesRead;
+    while ((bytesRead = stream->read(buffer.data(), (int32)buffer.size())) > 0)
+    {
+        for (int32 i = 0; i < bytesRead; i++)
+        {
+            fingerprint.hash = (fingerprint.hash ^ buffer[i]) * 0x100000001B3ULL;
+            fingerprint.check = (fingerprint.check ^ buffer[i]) * 0xFF51AFD7ED558CCDULL;
+            fingerprint.check ^= fingerprint.check >> 29;
+        }
+        fingerprint.bytes += bytesRead;
+    }
+    stream->close();
+    return bytesRead == 0;
+}
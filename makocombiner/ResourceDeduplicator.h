@@ -0,0 +1,108 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ResourceDeduplicator.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// Shares identical images and fonts between the pages of all the inputs, so that each is written once.
+// Each input brings its own copy of a resource it has in common with another, such as a logo or an embedded
+// font, and they are written separately unless the pages refer to the same object. So the first of each is
+// kept, and every identical one found later, by its kind and description and the size and hash of its data,
+// is replaced with it.
+class ResourceDeduplicator
+{
+public:
+    explicit ResourceDeduplicator(const IJawsMakoPtr& mako) : m_mako(mako)
+    {
+    }
+
+    // Replace the images and fonts on a page with identical ones already seen. May be called from any thread.
+    void share(const IDOMFixedPagePtr& content);
+
+    // The number of images and fonts replaced, and the size of their data
+    uint32 getSharedCount() const;
+    uint64 getBytesSaved() const;
+
+private:
+    struct sFingerprint
+    {
+        size_t type;            // The concrete type of the object, eg a JPEG or a PDF image, or a TrueType font
+        uint32 width;           // For an image, what it is decoded to, as the same data may be read differently
+        uint32 height;
+        uint8 bpc;
+        uint8 channels;
+        int32 colorSpace;
+        uint64 firstRow;        // The hash of the first decoded row, which differs if a decode array inverts the samples
+        uint64 bytes;
+        uint64 hash;
+        uint64 check;           // A second, independent hash, so that a match is all but certain
+
+        bool operator==(const sFingerprint& other) const
+        {
+            return type == other.type && width == other.width && height == other.height && bpc == other.bpc && channels == other.channels
+                && colorSpace == other.colorSpace && firstRow == other.firstRow && bytes == other.bytes && hash == other.hash && check == other.check;
+        }
+    };
+
+    struct sFingerprintHash
+    {
+        size_t operator()(const sFingerprint& fingerprint) const
+        {
+            return (size_t)fingerprint.hash;
+        }
+    };
+
+    // An object that has been fingerprinted, and what it is replaced with. The object is held so that its address
+    // cannot be reused by another while it is in the list.
+    template <typename T>
+    struct sSeen
+    {
+        const void* object;
+        T resource;
+        T shared;
+    };
+
+    // The resources of one kind seen so far. Only the most recently seen objects are remembered, so that the objects
+    // of inputs long since written are let go; one seen again after that is simply fingerprinted again.
+    template <typename T>
+    struct sResources
+    {
+        typedef std::list<sSeen<T>> SeenList;
+
+        std::unordered_map<sFingerprint, T, sFingerprintHash> byFingerprint;
+        SeenList seen;                                                      // Most recently used first
+        std::unordered_map<const void*, typename SeenList::iterator> seenByObject;
+        uint32 sharedCount = 0;
+        uint64 bytesSaved = 0;
+    };
+
+    template <typename T>
+    T share(sResources<T>& resources, const T& resource);
+    template <typename T>
+    static bool findSeen(sResources<T>& resources, const void* object, T& shared);
+
+    static bool shareResources(void* priv, const IDOMNodePtr& node);
+    bool describe(const IDOMImagePtr& image, sFingerprint& fingerprint) const;
+    bool describe(const IDOMFontPtr& font, sFingerprint& fingerprint) const;
+    static bool fingerprintStream(const IRAInputStreamPtr& stream, sFingerprint& fingerprint);
+
+    IJawsMakoPtr m_mako;
+    mutable std::mutex m_mutex;
+    sResources<IDOMImagePtr> m_images;
+    sResources<IDOMFontPtr> m_fonts;
+};
@@ -10,12 +10,19 @@
 // -----------------------------------------------------------------------
 
 #include <algorithm>
+#include <atomic>
 #include <exception>
-#include <codecvt>
-#include <fstream>
+#include <functional>
 #include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 
 #include <fcntl.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdexcept>
 #include <wctype.h>
@@ -27,18 +34,29 @@
 #include <fcntl.h>
 #include <corecrt_io.h>
 #include <direct.h>
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
 #endif
 
-#include "BookMarkTreeNode.h"
+#include "BookmarkOutline.h"
+#include "FormFields.h"
+#include "InputCache.h"
+#include "JobManifest.h"
 #include "NamedDestinations.h"
 #include "Layers.h"
+#include "OrderedPrefetcher.h"
+#include "PageIdIndex.h"
+#include "ResourceDeduplicator.h"
 #include <edl/idommetadata.h>
 
 using namespace JawsMako;
 using namespace EDL;
 
 // Controls if appendPage() is used with a source document parameter
-// If true, processing is slower but the copying of the page more thorough, eg copying bookmarks and form field metadata
+// If true, processing is slower but the copying of the page more thorough, eg copying bookmarks and form field metadata.
+// Otherwise, the bookmarks, and the form fields (with FormFields), are merged separately.
 static const bool deepCopy = false;
 
 struct sPageRange
@@ -55,11 +73,109 @@ struct sArgument
     String modifier;
     eFileFormat fileFormat;
     std::vector<sPageRange> pageRanges;
+    U8String password;
+    String label;               // For the bookmark of the file, if not its name
+    uint32 inputIndex = 0;      // The position of the input in the list of inputs, from 1, for making clashing names unique
+    std::shared_ptr<const DestinationInputs> destinationInputs;    // For a part combined earlier, the input each of its named destinations came from
+};
+
+// An input named on the command line, or a list of inputs (a manifest), read as the inputs are needed
+struct sInputSource
+{
+    sArgument argument;
+    std::shared_ptr<JobManifest> manifest;
+};
+
+// Settings given as setting=value
+struct sSettings
+{
+    uint32 threadCount = 0;
+    uint32 lookahead = 0;
+    bool streaming = false;
+    bool deduplicate = false;
+    bool mergeLayers = false;
+    uint32 partSize = 0;        // Combine in parts of this many inputs, on several threads, then combine the parts
+    uint32 reuseCount = 16;     // How many of the inputs opened most recently are kept open, to be reused should they appear again
+    uint32 maxOpenInputs = 0;   // How many inputs may be held open at once without streaming. Zero means as the limit on open files allows.
+};
+
+// Where a combined file is written, and how
+struct sCombineJob
+{
+    String outputFilePath;
+    eFileFormat outputFileFormat = eFFUnknown;
+    String appendFilePath;          // A PDF that is added to (/a), which is also the output
+    bool combinedInputs = false;    // The inputs are parts combined earlier, whose bookmarks and layers are kept as they are
+    bool quiet = false;             // Do not report each input, as when parts are combined on several threads at once
+    bool emptyAllowed = false;      // Having no inputs to combine is not an error; nothing is written
+    std::shared_ptr<DestinationInputs> destinationInputs;  // If set, filled in with the input each named destination came from
+};
+
+// Gives the inputs to combine in turn, returning false when there are no more
+typedef std::function<bool(sArgument& argument)> NextArgumentFunc;
+
+// Counts the inputs that are opened, as the input cache (r=) opens them, so that an input appearing again while it is
+// still cached does not count against the limit on open inputs (o=). Inputs are matched by path and password alone,
+// so a file with the same content as another, under another name, counts again; the count is never too low.
+class OpenInputCounter
+{
+public:
+    explicit OpenInputCounter(const uint32 capacity) : m_capacity(capacity), m_count(0)
+    {
+    }
+
+    // Count an input, returning the number opened with it
+    uint32 add(const sArgument& argument)
+    {
+        if (m_capacity)
+        {
+            const std::string key = std::string(StringToU8String(argument.fullPath).c_str()) + '\n' + argument.password.c_str();
+            const auto found = m_byKey.find(key);
+            if (found != m_byKey.end())
+            {
+                m_recent.splice(m_recent.begin(), m_recent, found->second);
+                return m_count;
+            }
+            m_recent.push_front(key);
+            m_byKey[key] = m_recent.begin();
+            if (m_recent.size() > m_capacity)
+            {
+                m_byKey.erase(m_recent.back());
+                m_recent.pop_back();
+            }
+        }
+        return ++m_count;
+    }
+
+    uint32 getCount() const
+    {
+        return m_count;
+    }
+
+private:
+    uint32 m_capacity;
+    uint32 m_count;
+    std::list<std::string> m_recent;    // Most recently used first
+    std::unordered_map<std::string, std::list<std::string>::iterator> m_byKey;
+};
+
+static const char* emptyMessage = "\n   The input file list is empty. \n   This may be because the filenames cannot be read from the text file, or that the files cannot be found.";
+
+// An input opened and interpreted ahead of the appender, with everything that is to be merged from it
+struct sPreparedInput
+{
+    sArgument argument;
+    bool missing = false;                       // The file could not be found, so is skipped
+    bool uninterpreted = false;                 // The pages are appended without being interpreted
+    OpenedInputPtr source;                      // Shared by every occurrence of the same input
+    bool reused = false;                        // The input was opened for an earlier occurrence, so its pages are copies
+    std::vector<sPageRange> pageRanges;         // Adjusted to the number of pages in the document
+    std::vector<IPagePtr> pages;                // The pages of all the ranges, in order
 };
 
 static void usage()
 {
-    std::wcout << "Mako Combiner(single thread) v1.2.0" << std::endl << std::endl;
+    std::wcout << "Mako Combiner v1.2.0" << std::endl << std::endl;
     std::wcout << L"Usage:" << std::endl;
     std::wcout << L"   makocombiner <source file 1.xxx> <source file 2.xxx> .. <source file n.xxx>" << std::endl;
     std::wcout << L"                Combines (merges) multiple files into a single file." << std::endl;
@@ -71,9 +187,29 @@ static void usage()
     std::wcout << L"                  - A range of n- means from n to end." << std::endl;
     std::wcout << L"                  - Invalid page ranges are adjusted automatically or ignored." << std::endl;
     std::wcout << L"                <filename>/o indicates the file is the output file." << std::endl;
+    std::wcout << L"                <filename>/a indicates the file is a PDF to add to, with an incremental update. It is also the output file." << std::endl;
     std::wcout << L"                If no output file is declared, a default of 'Combined.xxx' will be used (where xxx matches the first named file)." << std::endl;
+    std::wcout << L"                t=<threads> the number of threads opening and interpreting the inputs ahead of the one appending" << std::endl;
+    std::wcout << L"                  them to the output. Omitted or 0 means one per available processor core." << std::endl;
+    std::wcout << L"                k=<inputs> how many inputs may be prepared ahead. Omitted or 0 means twice the number of threads." << std::endl;
+    std::wcout << L"                s=yes|no write the pages as they are appended, releasing each input once its pages are written," << std::endl;
+    std::wcout << L"                  so any number of inputs can be combined. Default is no, when every input is held open until the" << std::endl;
+    std::wcout << L"                  output is written, and more than o= inputs are combined in parts (see h=)." << std::endl;
+    std::wcout << L"                d=yes|no write images and fonts that are identical in several inputs only once. Default is no." << std::endl;
+    std::wcout << L"                m=yes|no merge layers with the same name into one layer, rather than listing the layers of" << std::endl;
+    std::wcout << L"                  each input under its own name. Default is no." << std::endl;
+    std::wcout << L"                h=<inputs> combine the inputs in parts of this many, on several threads, then combine the parts," << std::endl;
+    std::wcout << L"                  in as many rounds as needed. The result is the same as combining in one go. Omitted or 0 means" << std::endl;
+    std::wcout << L"                  all in one go, unless there are more than o= inputs. At most o=." << std::endl;
+    std::wcout << L"                o=<inputs> how many inputs may be held open at once, when not streaming. Omitted or 0 means as many" << std::endl;
+    std::wcout << L"                  as the limit on open files allows, up to 2048." << std::endl;
+    std::wcout << L"                r=<inputs> how many of the inputs opened most recently are kept open, so that an input that appears" << std::endl;
+    std::wcout << L"                  again (by path or content) is not opened again. Default is 16; 0 means none." << std::endl;
     std::wcout << L" -or-" << std::endl;
     std::wcout << L"   makocombiner <source file list (text file)> [<output file>] (to combine a list of files into the output file)" << std::endl;
+    std::wcout << L"                The list may be a .txt file, with one path to a line, a .csv file with path[,ranges[,password[,label]]]" << std::endl;
+    std::wcout << L"                on each line, or a .jsonl file with an object on each line, eg {\"path\": \"a.pdf\", \"ranges\": \"1-3\"}." << std::endl;
+    std::wcout << L"                The list is read as the files are needed, so combining starts straight away." << std::endl;
 }
 
 bool isSeparator(std::wistream& source, const wchar_t separ)
@@ -152,6 +288,16 @@ void processRange(std::vector<sPageRange>& results, std::wistream& source)
         results.push_back(pageRange);
 }
 
+// Parse page ranges, eg 10-20;80;90-
+static void processRanges(std::vector<sPageRange>& results, const String& ranges)
+{
+    std::wistringstream argument_ws(ranges.c_str());
+    processRange(results, argument_ws);
+    while (isSeparator(argument_ws, ';')) {
+        processRange(results, argument_ws);
+    }
+}
+
 // Split a command argument into parts
 static sArgument split_argument(const String &path)
 {
@@ -180,13 +326,7 @@ static sArgument split_argument(const String &path)
                     std::transform(modifier.begin(), modifier.end(), modifier.begin(), towlower);
                     argument.modifier = modifier.substr(0, 1);
                     if (modifier.length() > 1)    // Page range?
-                    {
-                        std::wistringstream argument_ws(modifier.c_str());
-                        processRange(argument.pageRanges, argument_ws);
-                        while (isSeparator(argument_ws, ';')) {
-                            processRange(argument.pageRanges, argument_ws);
-                        }
-                    }
+                        processRanges(argument.pageRanges, modifier);
                     //else
                     //    argument.pageRanges.push_back(emptyPageRange);
                 }
@@ -225,6 +365,60 @@ static bool fileExists(const String &path)
     return true;
 }
 
+// Replace a file with another, by renaming
+static void replaceFile(const String& from, const String& to)
+{
+#ifdef _WIN32
+    const bool replaced = MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    const bool replaced = rename(StringToU8String(from).c_str(), StringToU8String(to).c_str()) == 0;
+#endif
+    if (!replaced)
+    {
+        std::string message("Unable to replace ");
+        message += StringToU8String(to).c_str();
+        message += " with ";
+        message += StringToU8String(from).c_str();
+        throw std::runtime_error(message);
+    }
+}
+
+// How many inputs may be held open at once by default: as many as the limit on open files allows, less some for
+// the output and the like, up to 2048. On POSIX systems, the limit is first raised as far as it may be.
+static uint32 defaultMaxOpenInputs()
+{
+    const uint64 reserved = 64;
+#ifdef _WIN32
+    const uint64 limit = (uint64)_getmaxstdio();
+#else
+    struct rlimit limits;
+    if (getrlimit(RLIMIT_NOFILE, &limits) != 0)
+        return 256;
+    if (limits.rlim_cur != RLIM_INFINITY && limits.rlim_cur < limits.rlim_max)
+    {
+        rlimit raised = limits;
+        raised.rlim_cur = limits.rlim_max;
+        if (setrlimit(RLIMIT_NOFILE, &raised) == 0)
+            limits = raised;
+    }
+    const uint64 limit = limits.rlim_cur == RLIM_INFINITY ? 2048 + reserved : (uint64)limits.rlim_cur;
+#endif
+    return (uint32)std::min<uint64>(std::max<uint64>(limit, reserved * 2) - reserved, 2048);
+}
+
+// Remove the files written for parts, if they were written
+static void removeParts(const std::vector<sArgument>& parts)
+{
+    for (const auto& part : parts)
+    {
+#ifdef _WIN32
+        _wremove(part.fullPath.c_str());
+#else
+        remove(StringToU8String(part.fullPath).c_str());
+#endif
+    }
+}
+
 // Return filename without preceding path
 static String filenameWithoutPrecedingPath(const String &path)
 {
@@ -235,6 +429,184 @@ static String filenameWithoutPrecedingPath(const String &path)
     return U8StringToString(filepath.c_str());
 }
 
+static bool isYes(String value)
+{
+    std::transform(value.begin(), value.end(), value.begin(), towlower);
+    return value == L"yes" || value == L"true";
+}
+
+// An input read from a list
+static sArgument manifestArgument(const JobManifest::sEntry& entry)
+{
+    sArgument argument;
+    argument.fullPath = entry.path;
+    argument.ext = getExtension(entry.path);
+    argument.basename = entry.path.substr(0, entry.path.size() - argument.ext.size());
+    argument.fileFormat = formatFromExtension(argument.ext);
+    if (argument.fileFormat == eFFUnknown)
+    {
+        std::string message("Unsupported file type: ");
+        message += StringToU8String(entry.path).c_str();
+        throw std::invalid_argument(message);
+    }
+    if (!entry.ranges.empty())
+        processRanges(argument.pageRanges, entry.ranges);
+    argument.password = entry.password;
+    argument.label = entry.label;
+    return argument;
+}
+
+// An input that is a part combined earlier
+static sArgument partArgument(const String& path)
+{
+    JobManifest::sEntry entry;
+    entry.path = path;
+    return manifestArgument(entry);
+}
+
+// The next input from the command line, or from the lists on it, which are read only as far as needed.
+// inputCount counts the inputs given so far, and so gives each its position.
+static bool nextArgument(const std::vector<sInputSource>& inputSources, size_t& sourceIndex, uint32& inputCount, sArgument& argument)
+{
+    for (; sourceIndex < inputSources.size(); sourceIndex++)
+    {
+        const sInputSource& source = inputSources[sourceIndex];
+        if (!source.manifest)
+        {
+            argument = source.argument;
+            argument.inputIndex = ++inputCount;
+            sourceIndex++;
+            return true;
+        }
+
+        JobManifest::sEntry entry;
+        if (source.manifest->next(entry))
+        {
+            argument = manifestArgument(entry);
+            argument.inputIndex = ++inputCount;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parse an argument of the form setting=value, if that is what it is
+static bool parseSetting(const String& arg, sSettings& settings)
+{
+    const size_t equalsPos = arg.find('=');
+    if (equalsPos == String::npos || !equalsPos || !std::all_of(arg.begin(), arg.begin() + equalsPos, iswalpha))
+        return false;
+
+    String setting = arg.substr(0, equalsPos);
+    std::transform(setting.begin(), setting.end(), setting.begin(), towlower);
+    const String value = arg.substr(equalsPos + 1);
+    try
+    {
+        if (setting == L"t")
+            settings.threadCount = std::stoul(value.c_str());
+        else if (setting == L"k")
+            settings.lookahead = std::stoul(value.c_str());
+        else if (setting == L"s")
+            settings.streaming = isYes(value);
+        else if (setting == L"d")
+            settings.deduplicate = isYes(value);
+        else if (setting == L"m")
+            settings.mergeLayers = isYes(value);
+        else if (setting == L"h")
+            settings.partSize = std::stoul(value.c_str());
+        else if (setting == L"r")
+            settings.reuseCount = std::stoul(value.c_str());
+        else if (setting == L"o")
+            settings.maxOpenInputs = std::stoul(value.c_str());
+        else
+            return false;
+    }
+    catch (std::exception)
+    {
+        String message(L"Invalid value: ");
+        message += arg;
+        throw std::invalid_argument(StringToU8String(message).c_str());
+    }
+    return true;
+}
+
+// Open an input and fetch the pages to be copied, and the bookmarks, named destinations and layers to go with them.
+// The pages of XPS, PCL5 and PCL/XL are interpreted too, as that is the costly part of merging such an input, so it is
+// done by a number of threads ahead of the appender, leaving it little more to do than add what is prepared to the output.
+// Inputs from a list are only looked for now, so one that cannot be found is skipped, as it would have been when the list was read.
+// With uninterpretedPdfPages, the pages of a PDF for PDF output are left uninterpreted, and appended as they are fetched.
+// An input that was opened for an earlier occurrence, and is still in the cache, is not opened again.
+static void prepareInput(const IJawsMakoPtr& jawsMako, const eFileFormat outputFileFormat, ResourceDeduplicator* deduplicator,
+    const bool uninterpretedPdfPages, InputCache& inputCache, sPreparedInput& prepared)
+{
+    const sArgument& argument = prepared.argument;
+    if (!fileExists(argument.fullPath))
+    {
+        prepared.missing = true;
+        return;
+    }
+
+    prepared.source = inputCache.open(argument.fullPath, argument.password, [&](sOpenedInput& opened)
+        {
+            // INPUT: Create an input for the file format
+            IInputPtr input = IInput::create(jawsMako, argument.fileFormat);
+            if (argument.fileFormat == eFFPDF && argument.password.size())
+                obj2IPDFInput(input)->setPassword(argument.password);
+            opened.document = input->open(argument.fullPath)->getDocument();
+            opened.sourcePages = PageIdIndex(opened.document);
+
+            // Collect the bookmarks (not needed if a deep copy is specified, as that copies bookmarks automatically)
+            if (!deepCopy)
+                opened.bookmarks = BookmarkOutline(opened.document, opened.sourcePages);
+
+            // Named destinations and OCG information (layers) are only copied to PDF
+            if (outputFileFormat == eFFPDF)
+                opened.namedDestinations = opened.document->getNamedDestinations();
+            if (argument.fileFormat == eFFPDF && outputFileFormat == eFFPDF)
+                opened.optionalContent = opened.document->getOptionalContent();
+
+            // As are form fields, which a deep copy would copy with the pages
+            if (!deepCopy && argument.fileFormat == eFFPDF && outputFileFormat == eFFPDF)
+                opened.form = opened.document->getForm();
+        }, prepared.reused);
+    prepared.uninterpreted = uninterpretedPdfPages && argument.fileFormat == eFFPDF && outputFileFormat == eFFPDF;
+
+    sOpenedInput& source = *prepared.source;
+    const uint32 pageCount = source.sourcePages.getCount();
+    prepared.pageRanges = argument.pageRanges;
+    if (!prepared.pageRanges.size())
+    {
+        // Create default page range
+        sPageRange dpr;
+        dpr.lastPage = pageCount;
+        prepared.pageRanges.emplace_back(dpr);
+    }
+
+    for (auto& pageRange : prepared.pageRanges)
+    {
+        // Adjust out of range page numbers
+        if (pageRange.firstPage > pageCount)
+            pageRange.firstPage = pageCount;
+
+        // A last page number of zero means until the end
+        if (pageRange.lastPage == 0 || pageRange.lastPage > pageCount)
+            pageRange.lastPage = pageCount;
+
+        // Interpret the pages, unless they are to be appended uninterpreted. Those of an input that is reused are only
+        // interpreted the first time.
+        std::lock_guard<std::mutex> lock(source.mutex);
+        for (uint32 pageIndex = pageRange.firstPage - 1; pageIndex < pageRange.lastPage; pageIndex++)
+        {
+            IPagePtr sourcePage = source.document->getPage(pageIndex);
+            if (deduplicator)
+                deduplicator->share(sourcePage->edit());
+            else if (!prepared.uninterpreted)
+                sourcePage->getContent();
+            prepared.pages.push_back(sourcePage);
+        }
+    }
+}
+
 // Create a new outline (bookmark) node with a description and target
 IDOMOutlineTreeNodePtr makeOutlineNode(IJawsMakoPtr jawsMako, uint32 pageIndex, String entry)
 {
@@ -255,6 +627,461 @@ IDOMOutlineTreeNodePtr makeOutlineNode(IJawsMakoPtr jawsMako, uint32 pageIndex,
     return newNode;
 }
 
+// Combine the inputs into the output, in order. Returns the number of inputs combined.
+static uint32 combine(const IJawsMakoPtr& jawsMako, const sSettings& settings, const sCombineJob& job,
+    const NextArgumentFunc& nextArgument, ResourceDeduplicator* deduplicator)
+{
+    const String& outputFilePath = job.outputFilePath;
+    const String& appendFilePath = job.appendFilePath;
+    const eFileFormat outputFileFormat = job.outputFileFormat;
+
+    // OUTPUT: Create an empty assembly, document, outline, named destinations list and optional content 
+    IDocumentAssemblyPtr assembly;
+    IDocumentPtr document;
+    NamedDestinations namedDestinations(jawsMako);
+    Layers layers(jawsMako, settings.mergeLayers);
+    FormFields formFields(jawsMako);
+    PageIdIndex targetPages;
+    if (appendFilePath.empty())
+    {
+        assembly = IDocumentAssembly::create(jawsMako);
+        document = IDocument::create(jawsMako);
+        IDOMOutlinePtr destOutline = IDOMOutline::create(jawsMako);
+        document->setOutline(destOutline); // new 4.3 API
+        assembly->appendDocument(document);
+    }
+    else
+    {
+        // Or open the PDF being added to (/a), keeping its pages, outline, named destinations and optional content.
+        // Only what is added is written, as an incremental update.
+        assembly = IInput::create(jawsMako, eFFPDF)->open(appendFilePath);
+        document = assembly->getDocument();
+        if (!document->getOutline())
+            document->setOutline(IDOMOutline::create(jawsMako));
+        namedDestinations.appendAll(document);
+        layers.appendExisting(document->getOptionalContent());
+        formFields.appendExisting(document->getForm());
+        targetPages = PageIdIndex(document);
+    }
+
+    // Set the viewer preferences so that the outline is visible when the file is opened (PDF only)
+    if (outputFileFormat == eFFPDF && appendFilePath.empty())
+    {
+        IDOMMetadataPtr metadata = IDOMMetadata::create(jawsMako);
+        if (metadata->setProperty(IDOMMetadata::ePageView, "PageMode", PValue(String(L"UseOutlines"))))
+            assembly->setJobMetadata(metadata);
+        else
+            std::cout << "Could not set PDF viewer preferences" << std::endl;
+    }
+
+    // When streaming (s=yes), the pages are written as they are appended, rather than all at the end, so each input
+    // can be released as soon as its pages are written. The outline, named destinations and layers, which refer to
+    // the pages by their ids, are added to the document once all the pages are written, before it is ended.
+    // Either way, the id of each page is recorded as it is added to the output.
+    IOutputPtr output = IOutput::create(jawsMako, outputFileFormat);
+    IOutputWriterPtr outputWriter;
+    if (settings.streaming)
+    {
+        if (!job.quiet)
+        {
+            std::wcout << L"Writing \'";
+            std::wcerr << outputFilePath;
+            std::wcout << L"\'...";
+            std::wcerr << std::endl;
+        }
+        outputWriter = output->openWriter(assembly, outputFilePath);
+        outputWriter->beginDocument(document);
+    }
+
+    // Open and interpret the inputs on a number of threads, a few inputs ahead of this one, which appends them in order.
+    const auto nextInput = [&](uint32, sPreparedInput& prepared)
+    {
+        return nextArgument(prepared.argument);
+    };
+
+    // Identical images and fonts are shared, if there is a deduplicator (d=yes), as the pages are prepared.
+    // Otherwise, unless layers are to be merged, which may mean changing them, PDF pages are appended to PDF output uninterpreted.
+    // An input that appears more than once, such as terms and conditions after every statement, is only opened once.
+    const uint32 threadCount = settings.threadCount ? settings.threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+    const bool uninterpretedPdfPages = !deduplicator && !settings.mergeLayers;
+    // Without streaming, every input opened is held open until the end, so the number of inputs opened is limited.
+    // An input reused from the cache is already open. Any more should have been combined in parts.
+    InputCache inputCache(settings.reuseCount);
+    std::atomic<uint32> openedCount(0);
+    OrderedPrefetcher<sPreparedInput> prefetcher(threadCount, settings.lookahead ? settings.lookahead : threadCount * 2, nextInput,
+        [&](uint32, sPreparedInput& prepared)
+        {
+            prepareInput(jawsMako, outputFileFormat, deduplicator, uninterpretedPdfPages, inputCache, prepared);
+            if (!settings.streaming && !prepared.missing && !prepared.reused && ++openedCount > settings.maxOpenInputs)
+                throw std::length_error("Too many inputs to hold open at once");
+        });
+
+    // Process each of the input documents
+    uint32 inputCount = 0;
+    size_t uninterpretedPageCount = 0;
+    for (;;)
+    {
+        sPreparedInput prepared;
+        if (!prefetcher.take(prepared))
+            break;
+
+        const sArgument& argument = prepared.argument;
+        if (prepared.missing)
+        {
+            if (job.quiet)
+                continue;
+            std::wcout << L"Skipping \'";
+            std::wcerr << argument.fullPath;
+            std::wcout << L"\', which cannot be found";
+            std::wcerr << std::endl;
+            continue;
+        }
+
+        inputCount++;
+        if (prepared.uninterpreted)
+            uninterpretedPageCount += prepared.pages.size();
+        sOpenedInput& source = *prepared.source;
+        IDocumentPtr sourceDocument = source.document;
+        if (!job.quiet)
+        {
+            std::wcout << L"Processing \'";
+            std::wcerr << argument.fullPath;
+            std::wcout << L"\'...";
+            std::wcerr << std::endl;
+        }
+
+        // Save the position of where the appended document begins
+        uint32 targetDocumentPageIndex = targetPages.getCount();
+
+        // Where each source page has been copied to, by index, for the named destinations
+        std::unordered_map<uint32, uint32> copiedPages;
+
+        // Append OCG information (layers) (PDF only). This comes first, as where layers are merged (m=yes),
+        // the pages must be pointed at the layers they were merged into before they are appended.
+        // The pages of an input that is reused refer to the layers copied for its first occurrence.
+        const bool copyLayers = argument.fileFormat == eFFPDF && outputFileFormat == eFFPDF && !prepared.reused;
+        if (copyLayers && job.combinedInputs)
+            layers.AppendCombinedLayers(sourceDocument, source.optionalContent);
+        else if (copyLayers)
+            layers.AppendDocumentLayers(sourceDocument, source.optionalContent, StringToU8String(argument.basename));
+        const bool remapLayers = copyLayers && layers.hasContentToRemap();
+
+        // Create a bookmark for the document, under which its own bookmarks go. A part combined earlier already has
+        // a bookmark for each of its inputs, so its bookmarks go straight into the outline.
+        IDOMOutlineTreeNodePtr newNode = document->getOutline()->getOutlineTree()->getRoot();
+        if (!job.combinedInputs)
+        {
+            const String label = argument.label.size() ? argument.label : filenameWithoutPrecedingPath(argument.fullPath);
+            IDOMOutlineTreeNodePtr documentNode = makeOutlineNode(jawsMako, targetDocumentPageIndex, label);
+            newNode->appendChild(documentNode);
+            newNode = documentNode;
+        }
+
+        // The form fields of the input are merged once its pages are copied, keeping those with widgets on the copies.
+        // The fields of an input that is reused are merged for its first occurrence only, and the copies of its pages
+        // for later ones have their widgets removed, as there are no fields for them.
+        const bool copyFields = source.form && !prepared.reused;
+        const bool dropWidgets = source.form && prepared.reused;
+        std::vector<IPagePtr> appendedPages;
+
+        // Process each of the associated page ranges
+        std::lock_guard<std::mutex> lock(source.mutex);
+        uint32 preparedPageIndex = 0;
+        for (uint32 j = 0; j < prepared.pageRanges.size(); ++j)
+        {
+            const uint32 sourceFirstPageIndex = prepared.pageRanges[j].firstPage - 1;
+            const uint32 sourceLastPageIndex = prepared.pageRanges[j].lastPage - 1;
+
+            // Copy pages
+            for (uint32 pageIndex = sourceFirstPageIndex; pageIndex < prepared.pageRanges[j].lastPage; pageIndex++)
+            {
+                IPagePtr sourcePage = prepared.pages[preparedPageIndex++];
+                if (remapLayers)
+                    layers.remapContent(sourcePage->edit());
+
+                // An input that is reused has its pages copied, so that each occurrence has pages with ids of their own
+                // for its bookmarks and named destinations to target. The copies share the content, and resources, of the
+                // pages they copy, which are kept in memory while the input is held by the cache, so the resources are
+                // written once. They are released when the cache lets go of the input.
+                const bool keepPage = settings.reuseCount && !prepared.reused;
+                if (prepared.reused)
+                    sourcePage = sourcePage->clone();
+                if (dropWidgets)
+                    FormFields::dropWidgets(sourcePage);
+                copiedPages.emplace(pageIndex, targetPages.getCount());
+                if (outputWriter)
+                {
+                    outputWriter->writePage(sourcePage);
+                    targetPages.append(sourcePage->getPageId());
+                }
+                else
+                {
+                    if (!deepCopy)
+                        document->appendPage(sourcePage);
+                    else
+                        document->appendPage(sourcePage, sourceDocument);
+                    targetPages.append(document->getPage(targetPages.getCount())->getPageId());
+                }
+                if (copyFields)
+                    appendedPages.push_back(sourcePage);
+                if (keepPage)
+                    source.keepPage(sourcePage);
+                else
+                    sourcePage->release();
+            }
+
+            // Copy bookmarks
+            if (!deepCopy && !source.bookmarks.empty())
+            {
+                const int sourceToTargetPageDelta = targetDocumentPageIndex - sourceFirstPageIndex;
+                source.bookmarks.appendRange(newNode, sourceFirstPageIndex, sourceLastPageIndex, sourceToTargetPageDelta, targetPages, jawsMako);
+            }
+
+            // Move up the start position in the target document for the next range of pages
+            targetDocumentPageIndex += sourceLastPageIndex - sourceFirstPageIndex + 1;
+        }
+
+        if (copyFields)
+            formFields.appendCopied(source.form, appendedPages);
+
+        // Append named destinations in the source to the target (PDF only)
+        if (outputFileFormat == eFFPDF)
+        {
+            // The names from a part combined earlier are made unique with the position of the input each came from
+            namedDestinations.appendCopied(source.namedDestinations, source.sourcePages,
+                [&](uint32 sourcePageIndex, DOMid& targetPageId)
+                {
+                    const auto copied = copiedPages.find(sourcePageIndex);
+                    if (copied == copiedPages.end())
+                        return false;
+                    targetPageId = targetPages.getPageId(copied->second);
+                    return true;
+                }, argument.inputIndex, argument.destinationInputs.get());
+        }
+    }
+
+    if (!inputCount && job.emptyAllowed)
+        return 0;
+    if (!inputCount)
+        throw std::invalid_argument(emptyMessage);
+
+    // Set new Named Destinations (PDF only)
+    if (outputFileFormat == eFFPDF)
+        document->setNamedDestinations(namedDestinations.getList()); // new 4.6 API
+    if (job.destinationInputs)
+        *job.destinationInputs = namedDestinations.getInputs();
+
+    // Add copied layer information (PDF only)
+    if (outputFileFormat == eFFPDF)
+        document->setOptionalContent(layers.getLayers());
+
+    // Add the merged form fields (PDF only)
+    if (outputFileFormat == eFFPDF && !formFields.empty())
+        document->setForm(formFields.getForm());
+
+    // Now we can write this out, or complete the output if the pages have been written already
+    if (outputWriter)
+    {
+        outputWriter->endDocument();
+        outputWriter->finish();
+    }
+    else if (appendFilePath.size())
+    {
+        // The update is written with a copy of the original, which then replaces it, so the PDF is never left half written
+        std::wcout << L"Updating \'";
+        std::wcerr << outputFilePath;
+        std::wcout << L"\'...";
+        std::wcerr << std::endl;
+        const String updatedFilePath = appendFilePath + L".update";
+        obj2IPDFOutput(output)->setEnableIncrementalOutput(true);
+        output->writeAssembly(assembly, updatedFilePath);
+
+        // Let go of the original before replacing it
+        document = IDocumentPtr();
+        assembly = IDocumentAssemblyPtr();
+        replaceFile(updatedFilePath, appendFilePath);
+    }
+    else
+    {
+        if (!job.quiet)
+        {
+            std::wcout << L"Writing \'";
+            std::wcerr << outputFilePath;
+            std::wcout << L"\'...";
+            std::wcerr << std::endl;
+        }
+        output->writeAssembly(assembly, outputFilePath);
+    }
+
+    if (uninterpretedPageCount && !job.quiet)
+        std::wcout << L"Appended " << uninterpretedPageCount << L" PDF pages uninterpreted." << std::endl;
+    if (inputCache.getReuseCount() && !job.quiet)
+        std::wcout << L"Reused " << inputCache.getReuseCount() << L" inputs that were already open." << std::endl;
+    return inputCount;
+}
+
+// Combine the inputs in parts on several threads, each part being written to a file of its own. The parts are combined
+// in further rounds, in the same way, until there are few enough to combine into the output. The bookmarks, named
+// destinations and layers of each part are carried into the next round as they are, so the output is as it would be
+// had the inputs been combined in one go. The parts are PDF, whatever the output, so nothing is lost along the way.
+// The inputs of the first round are taken as they are needed, each thread taking the inputs of its next part in turn,
+// so a long list starts to be combined straight away. An input that cannot be found is skipped as it is prepared.
+static void combineInParts(const IJawsMakoPtr& jawsMako, const sSettings& settings, const sCombineJob& job,
+    const NextArgumentFunc& nextArgument, ResourceDeduplicator* deduplicator)
+{
+    // A part holds its inputs open until it is written, so there are only as many threads as keep within the limit.
+    // A part takes inputs until it has partSize to open, an input it already has open not counting again.
+    const uint32 partSize = std::min<uint32>(std::max<uint32>(settings.partSize, 2), std::max<uint32>(settings.maxOpenInputs, 2));
+    const uint32 threadCount = std::max<uint32>(std::min<uint32>(settings.threadCount ? settings.threadCount : std::max(std::thread::hardware_concurrency(), 1u),
+        settings.maxOpenInputs / partSize), 1);
+
+    // Each part is combined by a single thread, with another opening its inputs
+    sSettings partSettings = settings;
+    partSettings.threadCount = 1;
+    partSettings.lookahead = 2;
+
+    // Read ahead to see if there are more inputs than one part would open. If not, they are combined in one go.
+    std::vector<sArgument> arguments;
+    sArgument argument;
+    OpenInputCounter readAhead(settings.reuseCount);
+    while (readAhead.getCount() <= partSize && nextArgument(argument))
+    {
+        arguments.push_back(argument);
+        readAhead.add(argument);
+    }
+
+    uint32 toOpen = readAhead.getCount();
+    uint32 round = 0;
+    while (toOpen > partSize)
+    {
+        round++;
+
+        // The inputs of the round: those read so far, then, in the first round, the rest of the lists
+        size_t next = 0;
+        const auto nextRoundInput = [&](sArgument& input)
+        {
+            if (next < arguments.size())
+            {
+                input = arguments[next++];
+                return true;
+            }
+            return round == 1 && nextArgument(input);
+        };
+        if (round == 1)
+            std::wcout << L"Combining the inputs in parts..." << std::endl;
+        else
+            std::wcout << L"Combining the " << arguments.size() << L" parts in further parts..." << std::endl;
+
+        // The threads take the inputs of the next part in turn. The first error stops them, and is passed on once they finish.
+        std::vector<sArgument> parts;
+        std::vector<char> partsWritten;
+        std::exception_ptr error;
+        std::mutex partsMutex;
+        const auto combineParts = [&]()
+        {
+            for (;;)
+            {
+                try
+                {
+                    sCombineJob partJob;
+                    std::vector<sArgument> partInputs;
+                    size_t part;
+                    {
+                        std::lock_guard<std::mutex> lock(partsMutex);
+                        if (error)
+                            return;
+                        OpenInputCounter opened(settings.reuseCount);
+                        sArgument input;
+                        while (opened.getCount() < partSize && nextRoundInput(input))
+                        {
+                            partInputs.push_back(input);
+                            opened.add(input);
+                        }
+                        if (partInputs.empty())
+                            return;
+                        part = parts.size();
+                        parts.push_back(partArgument(job.outputFilePath + L".part" + std::to_wstring(round).c_str() + L"-" + std::to_wstring(part).c_str() + L".pdf"));
+                        partsWritten.push_back(false);
+                        partJob.outputFilePath = parts[part].fullPath;
+                    }
+
+                    partJob.outputFileFormat = eFFPDF;
+                    partJob.combinedInputs = round > 1;
+                    partJob.destinationInputs = std::make_shared<DestinationInputs>();
+                    partJob.quiet = true;
+                    partJob.emptyAllowed = true;
+                    size_t nextPartInput = 0;
+                    const uint32 combined = combine(jawsMako, partSettings, partJob, [&](sArgument& input)
+                        {
+                            if (nextPartInput == partInputs.size())
+                                return false;
+                            input = partInputs[nextPartInput++];
+                            return true;
+                        }, nullptr);
+
+                    std::lock_guard<std::mutex> lock(partsMutex);
+                    partsWritten[part] = combined != 0;
+                    parts[part].destinationInputs = partJob.destinationInputs;
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(partsMutex);
+                    if (!error)
+                        error = std::current_exception();
+                    return;
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for (uint32 i = 0; i < threadCount; i++)
+            threads.emplace_back(combineParts);
+        for (auto& thread : threads)
+            thread.join();
+
+        // The parts of the previous round are no longer needed, nor are those of this one if it failed
+        if (round > 1)
+            removeParts(arguments);
+        if (error)
+        {
+            removeParts(parts);
+            std::rethrow_exception(error);
+        }
+
+        // A part none of whose inputs could be found is dropped
+        arguments.clear();
+        std::vector<sArgument> emptyParts;
+        for (size_t part = 0; part < parts.size(); part++)
+            (partsWritten[part] ? arguments : emptyParts).push_back(parts[part]);
+        removeParts(emptyParts);
+        toOpen = (uint32)arguments.size();
+    }
+
+    // Combine the parts (or the inputs, if there are few enough) into the output. Identical images and fonts (d=yes)
+    // are shared only now, when they can be found across all the parts.
+    sCombineJob finalJob = job;
+    finalJob.combinedInputs = round > 0;
+    size_t next = 0;
+    try
+    {
+        combine(jawsMako, settings, finalJob, [&](sArgument& input)
+            {
+                if (next == arguments.size())
+                    return false;
+                input = arguments[next++];
+                return true;
+            }, deduplicator);
+    }
+    catch (...)
+    {
+        if (round > 0)
+            removeParts(arguments);
+        throw;
+    }
+    if (round > 0)
+        removeParts(arguments);
+}
+
 #ifdef _WIN32
 int wmain(int argc, wchar_t *argv[])
 {
@@ -273,10 +1100,11 @@ int main(int argc, char *argv[])
 
         // Strings to hold arguments
         String outputFilePath;
+        String appendFilePath;
         eFileFormat outputFileFormat = eFFUnknown;
 
-        // Vector to hold list of files to be processed
-        CEDLVector<sArgument> inputFileList;
+        // Vector to hold the files to be processed, and lists of them
+        std::vector<sInputSource> inputSources;
 
         // Check number of arguments
         if (argc < 2)
@@ -288,6 +1116,7 @@ int main(int argc, char *argv[])
         // ReSharper disable once CppJoinDeclarationAndAssignment
         String arg;
         bool fileListDetected = false;
+        sSettings settings;
 
         // Process arguments
         for (uint16 i = 1; i < argc; i++)
@@ -298,12 +1127,23 @@ int main(int argc, char *argv[])
 #else
             arg = U8StringToString(U8String(argv[i]));
 #endif    
+            if (parseSetting(arg, settings))
+                continue;
+
             sArgument argument = split_argument(arg);
 
             // Add a PDF to the list of files to be processed, unless it's the output file
             if (argument.fileFormat != eFFUnknown)
             {
-                if (argument.modifier == L"o" || fileListDetected)
+                if (argument.modifier == L"a")
+                {
+                    if (argument.fileFormat != eFFPDF)
+                        throw std::invalid_argument("Only a PDF can be added to (/a)");
+                    appendFilePath = argument.fullPath;
+                    outputFilePath = argument.fullPath;
+                    outputFileFormat = argument.fileFormat;
+                }
+                else if (argument.modifier == L"o" || fileListDetected)
                 {
                     outputFilePath = argument.fullPath;
                     outputFileFormat = argument.fileFormat;
@@ -313,176 +1153,99 @@ int main(int argc, char *argv[])
                 {
                     if (fileExists(argument.fullPath))
                     {
-                        inputFileList.append(argument);
+                        inputSources.push_back({ argument, nullptr });
                     }
                 }
             }
 
-            // Read an input list of files to be processed. UTF8 supported
-            if (argument.ext == L".txt")
+            // A list of files to be processed, which is read as they are needed. UTF8 supported
+            if (JobManifest::isManifest(argument.ext))
             {
                 outputFileFormat = eFFPDF;
                 outputFilePath = argument.basename + extensionFromFormat(outputFileFormat);
                 fileListDetected = true;    // next arg is the output file (if there is one)
-
-                typedef std::codecvt_utf8_utf16<wchar_t, 0x10ffff, std::codecvt_mode::consume_header> MyCodeCvt;
-#ifdef _WIN32
-                std::wifstream myStream(arg.c_str());
-#else
-                std::wifstream myStream(StringToU8String(arg));
-#endif
-                std::locale myLocale(myStream.getloc(), new MyCodeCvt());
-                myStream.imbue(myLocale);
-                
-                wchar_t* line = new wchar_t[MAXPATHLEN];
-                myStream.getline(line, MAXPATHLEN);
-                while (wcslen(line)) {
-                    if (fileExists(line))
-                    {
-                        sArgument lineArg;
-                        lineArg.fullPath = line;
-                        lineArg.fileFormat = formatFromExtension(getExtension(String(line)));
-                        inputFileList.append(lineArg);
-                    }
-                    myStream.getline(line, MAXPATHLEN);
-                }
-                myStream.close();
-                delete[] line;
+                inputSources.push_back({ sArgument(), std::make_shared<JobManifest>(arg, argument.ext) });
             }
         }
 
-        // Use a default output filename, avoiding overwriting
+        if (inputSources.empty())
+        {
+            usage();
+            throw std::invalid_argument(emptyMessage);
+        }
+
+        // Use a default output filename, avoiding overwriting. There is always an output filename if there is a list of files.
         if (outputFilePath.size() == 0)
         {
+            const sArgument& firstInput = inputSources[0].argument;
             const String outputFileBase = L"Combined";
-            outputFilePath = outputFileBase + inputFileList[0].ext;
-            outputFileFormat = inputFileList[0].fileFormat;
+            outputFilePath = outputFileBase + firstInput.ext;
+            outputFileFormat = firstInput.fileFormat;
             uint16 i = 1;
             while(fileExists(outputFilePath))
             {
-                outputFilePath = String(outputFileBase + std::to_wstring(i++).c_str() + inputFileList[0].ext);
+                outputFilePath = String(outputFileBase + std::to_wstring(i++).c_str() + firstInput.ext);
             }
-        }        
-        
-        if (inputFileList.empty())
-        {
-            usage();
-            throw std::invalid_argument("\n   The input file list is empty. \n   This may be because the filenames cannot be read from the text file, or that the files cannot be found.");
         }
 
+        if (appendFilePath.size() && settings.streaming)
+            throw std::invalid_argument("A PDF that is added to (/a) cannot also be streamed (s=yes)");
+
         // Timer
         const clock_t begin = clock();
 
-        // OUTPUT: Create an empty assembly, document, outline, named destinations list and optional content 
-        IDocumentAssemblyPtr assembly = IDocumentAssembly::create(jawsMako);
-        IDocumentPtr document = IDocument::create(jawsMako);
-        IDOMOutlinePtr destOutline = IDOMOutline::create(jawsMako);
-        document->setOutline(destOutline); // new 4.3 API
-        assembly->appendDocument(document);
-        NamedDestinations namedDestinations(jawsMako);
-        Layers layers(jawsMako);
-
-        // Process each of the input documents
-        for (uint32 i = 0; i < inputFileList.size() && i < 2048; i++)
-        {
-            // INPUT: Create a PDF input
-            IInputPtr input = IInput::create(jawsMako, inputFileList[i].fileFormat);
-            IDocumentPtr sourceDocument = input->open(inputFileList[i].fullPath)->getDocument();
-            IDOMOutlinePtr sourceOutline = sourceDocument->getOutline();
-            std::wcout << L"Processing \'";
-            std::wcerr << inputFileList[i].fullPath;
-            std::wcout << L"\'...";
-            std::wcerr << std::endl;
+        // Identical images and fonts are shared (d=yes) as the pages are prepared
+        std::unique_ptr<ResourceDeduplicator> deduplicator(settings.deduplicate ? new ResourceDeduplicator(jawsMako) : nullptr);
 
-            // Save the position of where the appended document begins
-            uint32 targetDocumentPageIndex = document->getNumPages();
+        sCombineJob job;
+        job.outputFilePath = outputFilePath;
+        job.outputFileFormat = outputFileFormat;
+        job.appendFilePath = appendFilePath;
+        if (!settings.maxOpenInputs)
+            settings.maxOpenInputs = defaultMaxOpenInputs();
 
-            // Copy pages
-            const uint32 pageCount = sourceDocument->getNumPages();
-            if (!inputFileList[i].pageRanges.size())
+        // The inputs are taken from the command line, and from any lists, in turn, the lists being read only as far as needed
+        size_t sourceIndex = 0;
+        uint32 inputCount = 0;
+        std::vector<sArgument> arguments;
+        size_t readAhead = 0;
+        const NextArgumentFunc nextInput = [&](sArgument& next)
+        {
+            if (readAhead < arguments.size())
             {
-                // Create default page range
-                sPageRange dpr;
-                dpr.lastPage = pageCount;
-                inputFileList[i].pageRanges.emplace_back(dpr);
+                next = arguments[readAhead++];
+                return true;
             }
+            return nextArgument(inputSources, sourceIndex, inputCount, next);
+        };
 
-            // Create a bookmark for the document
-            IDOMOutlineTreeNodePtr newNode = makeOutlineNode(jawsMako, targetDocumentPageIndex, filenameWithoutPrecedingPath(inputFileList[i].fullPath));
-            document->getOutline()->getOutlineTree()->getRoot()->appendChild(newNode);
-
-            // Process each of the associated page ranges
-            int x = 0;
-            for (uint32 j = 0; j < inputFileList[i].pageRanges.size(); ++j, ++x)
-            {
-                // Adjust out of range page numbers
-                if (inputFileList[i].pageRanges[j].firstPage > pageCount)
-                    inputFileList[i].pageRanges[j].firstPage = pageCount;
-
-                // A last page number of zero means until the end
-                if (inputFileList[i].pageRanges[j].lastPage == 0 || inputFileList[i].pageRanges[j].lastPage > pageCount)
-                    inputFileList[i].pageRanges[j].lastPage = pageCount;
-
-                const uint32 sourceFirstPageIndex = inputFileList[i].pageRanges[j].firstPage - 1;
-                const uint32 sourceLastPageIndex = inputFileList[i].pageRanges[j].lastPage - 1;
-
-                // Copy pages
-                for (uint32 pageIndex = sourceFirstPageIndex; pageIndex < inputFileList[i].pageRanges[j].lastPage; pageIndex++)
-                {
-                    IPagePtr sourcePage = sourceDocument->getPage(pageIndex);
-                    if (!deepCopy)
-                        document->appendPage(sourcePage);
-                    else
-                        document->appendPage(sourcePage, sourceDocument); 
-                    sourcePage->release();
-                }
-
-                // Copy bookmarks (not needed if a deep copy is specified, as that copies bookmarks automatically)
-                if (!deepCopy)
-                {
-                    BookmarkTreeNode sourceBookmarks = BookmarkTreeNode::createFromDocument(sourceDocument, sourceFirstPageIndex, sourceLastPageIndex);
-                    if (sourceBookmarks.getChildCount(true))
-                        sourceBookmarks.appendToDocument(document, targetDocumentPageIndex - sourceFirstPageIndex, jawsMako, newNode);
-                }
-
-                // Move up the start position in the target document for the next range of pages
-                targetDocumentPageIndex += sourceLastPageIndex - sourceFirstPageIndex + 1;
-            }
-
-            // Append named destinations in the source to the target (PDF only)
-            if (outputFileFormat == eFFPDF)
-                namedDestinations.appendAll(sourceDocument);
-
-            // Append OCG information (layers) (PDF only)
-            if (inputFileList[i].fileFormat == eFFPDF && (outputFileFormat == eFFPDF))
-                layers.AppendDocumentLayers(sourceDocument, StringToU8String(inputFileList[i].basename));
+        // Without streaming, every input opened is held open until the output is written, so only so many (o=) can be
+        // combined in one go. Read ahead to see if more would be opened, in which case they are combined in parts.
+        OpenInputCounter opened(settings.reuseCount);
+        sArgument argument;
+        while (!settings.streaming && !settings.partSize && opened.getCount() <= settings.maxOpenInputs && nextArgument(inputSources, sourceIndex, inputCount, argument))
+        {
+            arguments.push_back(argument);
+            opened.add(argument);
         }
-
-        // Set new Named Destinations (PDF only)
-        if (outputFileFormat == eFFPDF)
-            document->setNamedDestinations(namedDestinations.getList()); // new 4.6 API
-
-        // Set the viewer preferences so that the outline is visible when the file is opened (PDF only)
-        if (outputFileFormat == eFFPDF)
+        if (!settings.partSize && opened.getCount() > settings.maxOpenInputs)
         {
-            IDOMMetadataPtr metadata = IDOMMetadata::create(jawsMako);
-            if (metadata->setProperty(IDOMMetadata::ePageView, "PageMode", PValue(String(L"UseOutlines"))))
-                assembly->setJobMetadata(metadata);
-            else
-                std::cout << "Could not set PDF viewer preferences" << std::endl;
+            const uint32 threadCount = settings.threadCount ? settings.threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+            settings.partSize = std::max<uint32>(settings.maxOpenInputs / threadCount, 2);
+            std::wcout << L"There are more than " << settings.maxOpenInputs << L" inputs to hold open, so they are combined in parts of "
+                << settings.partSize << L"." << std::endl;
         }
 
-        // Add copied layer information (PDF only)
-        if (outputFileFormat == eFFPDF)
-            document->setOptionalContent(layers.getLayers());
+        if (settings.partSize)
+            combineInParts(jawsMako, settings, job, nextInput, deduplicator.get());
+        else
+            combine(jawsMako, settings, job, nextInput, deduplicator.get());
 
-        // Now we can write this out
-        std::wcout << L"Writing \'";
-        std::wcerr << outputFilePath;
-        std::wcout << L"\'...";
-        std::wcerr << std::endl;
-        IOutputPtr output = IOutput::create(jawsMako, outputFileFormat);
-        output->writeAssembly(assembly, outputFilePath);
+        if (deduplicator)
+        {
+            std::wcout << L"Shared " << deduplicator->getSharedCount() << L" duplicate images and fonts, saving "
+                << deduplicator->getBytesSaved() << L" bytes." << std::endl;
+        }
 
         const clock_t end = clock();
         const double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
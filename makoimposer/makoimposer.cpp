@@ -9,14 +9,20 @@
 //  </summary>
 // -----------------------------------------------------------------------
 
+#include <chrono>
 #include <exception>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
+#include <thread>
+#include <vector>
 #include <wctype.h>
 #include <jawsmako/jawsmako.h>
 #include <jawsmako/pdfinput.h>
 #include <jawsmako/pdfoutput.h>
 #include "MakoPageSizes.h"
+#include "OrderedPrefetcher.h"
 #include <algorithm>
 #include <jawsmako/xpsoutput.h>
 #include <edl/idommetadata.h>
@@ -44,6 +50,25 @@ struct sParameters
     bool sequential;
     double spreadWidth;
     double spreadHeight;
+    uint32 threadCount;
+};
+
+// The size and number of the spreads, and the pages they are made from
+struct sImposition
+{
+    IDocumentPtr sourceDocument;
+    uint32 pageCount;
+    uint32 numSpreads;
+    double spreadWidth;
+    double spreadHeight;
+};
+
+// The transforms that make a spread. A transform is not to be used by two threads at once, so each thread
+// building spreads has its own.
+struct sSpreadTransforms
+{
+    IOverprintSimulationTransformPtr overprint;
+    IRendererTransformPtr renderer;
 };
 
 static void usage(std::map<String, sPageSize> pageSizes)
@@ -62,6 +87,7 @@ static void usage(std::map<String, sPageSize> pageSizes)
     std::wcout << L"   o=yes|no       Simulate overprint. Default is no, ie do not simulate overprint." << std::endl;
     std::wcout << L"   s=yes|no       Impose pages sequentially. Default is no, ie use booklet imposition" << std::endl;
     std::wcout << L"   p=pagesize     Page size chosen from the list below. Default is the size of a double page spread." << std::endl;
+    std::wcout << L"   t=<threads>    The number of threads building spreads. Default is 0, ie one per available processor core." << std::endl;
     std::wcout << std::endl;
 
     uint8 colCount = 0;
@@ -184,6 +210,7 @@ static sParameters parse_params(CEDLStringVect arguments, std::map<String, sPage
     params.sequential = false;
     params.simulateOverprint = false;
     params.flattenTransparency = false;
+    params.threadCount = 0;
 
     for (uint32 i = 0; i < arguments.size(); i++)
     {
@@ -244,6 +271,10 @@ static sParameters parse_params(CEDLStringVect arguments, std::map<String, sPage
                     if (value == L"yes" || value == L"true")
                         params.sequential = true;
                 }
+                else if (setting == L"t")
+                {
+                    params.threadCount = std::stoul(value.c_str());
+                }
                 else if (setting == L"p")
                 {
                     transform(value.begin(), value.end(), value.begin(), towupper);
@@ -467,6 +498,112 @@ while (child)
     // Done
 }
 
+// Report progress on a spread; spreads are built on several threads, so each line is written whole
+static void report(const wchar_t* message, const uint32 spreadIndex)
+{
+    static std::mutex reportMutex;
+    std::lock_guard<std::mutex> lock(reportMutex);
+    std::wcout << message << spreadIndex << L"..." << std::endl;
+}
+
+// Create the transforms for a thread building spreads
+static std::unique_ptr<sSpreadTransforms> createSpreadTransforms(const IJawsMakoPtr& jawsMako)
+{
+    std::unique_ptr<sSpreadTransforms> transforms(new sSpreadTransforms());
+
+    // Create the overprint simulation transform
+    transforms->overprint = IOverprintSimulationTransform::create(jawsMako);
+    transforms->overprint->setSimulateBlackDeviceGrayTextOverprint(false);
+    transforms->overprint->setResolution(600);
+
+    // Setup a renderer transform to perform transparency flattening.
+    transforms->renderer = IRendererTransform::create(jawsMako);
+    transforms->renderer->setTargetSpace(IDOMColorSpaceDeviceCMYK::create(jawsMako)); // Same colorspace as overprint transform
+    transforms->renderer->renderTransparentNodes(true); // Render transparent nodes
+    transforms->renderer->setResolution(600);
+    return transforms;
+}
+
+// Build a spread from the two pages that belong on it, simulating overprint and flattening transparency as required.
+// Spreads use different pages, so may be built on different threads at once, each with its own transforms.
+static IDOMFixedPagePtr buildSpread(const IJawsMakoPtr& jawsMako, const sParameters& params, const sImposition& imposition,
+    const sSpreadTransforms& transforms, const uint32 i)
+{
+    const IDocumentPtr& sourceDocument = imposition.sourceDocument;
+
+    // Pull the two pages required for the spread from the source document.
+    // Note that one or more of the sides may be blank
+    IPagePtr pageA;
+    uint32 pageANum;
+    if (params.sequential)
+        pageANum = i * 2;
+    else
+        pageANum = i;
+
+    if (pageANum < imposition.pageCount)
+    {
+        pageA = sourceDocument->getPage(pageANum);
+    }
+
+    IPagePtr pageB;
+    uint32 pageBNum;
+    if (params.sequential)
+        pageBNum = (i * 2) + 1;
+    else
+        pageBNum = (imposition.numSpreads * 2) - i - 1;
+
+    if (pageBNum < imposition.pageCount)
+    {
+        pageB = sourceDocument->getPage(pageBNum);
+    }
+
+    // If we're on an even spread (of a booklet), then pageA belongs on the right
+    if (!params.sequential && i % 2 == 0)
+    {
+        // Swap
+        IPagePtr tmp = pageA;
+        pageA = pageB;
+        pageB = tmp;
+    }
+
+    // Simulate overprint if required (transform the source pages)
+    if (params.simulateOverprint)
+    {
+        report(L"Simulating overprint on spread ", i);
+        // Drop overprint for DeviceCMYK text
+        if (pageA) {
+            pageA->edit()->walkTree(dropOverprintForCMYKBlackText, jawsMako, true, true);
+            transforms.overprint->transformPage(pageA);
+        }
+        if (pageB) {
+            pageB->edit()->walkTree(dropOverprintForCMYKBlackText, jawsMako, true, true);
+            transforms.overprint->transformPage(pageB);
+        }
+    }
+
+    // Create a new fixed page for the spread. Units are 1/96th of an inch
+    IDOMFixedPagePtr spread = IDOMFixedPage::create(jawsMako, imposition.spreadWidth, imposition.spreadHeight);
+
+    // Copy in the data for the left page
+    imposePage(jawsMako, spread, pageA, true);
+
+    // And the right
+    imposePage(jawsMako, spread, pageB, false);
+
+    // Flatten transparency if required
+    if (params.flattenTransparency) {
+        report(L"Flattening spread ", i);
+        bool changed;
+        spread = edlobj2IDOMFixedPage(transforms.renderer->transform(spread, changed));
+        if (!spread)
+        {
+            // This should never happen in practice.
+            throw std::runtime_error("Result of transparency flattening is null or not a page!?");
+        }
+    }
+    return spread;
+}
+
 #ifdef _WIN32
 int wmain(int argc, wchar_t *argv[])
 {
@@ -505,8 +642,8 @@ int main(int argc, char *argv[])
         const IJawsMakoPtr jawsMako = IJawsMako::create();
         IJawsMako::enableAllFeatures(jawsMako);
 
-        // Timer
-        const clock_t begin = clock();
+        // Timer; wall-clock time, as clock() would add up the time of every thread
+        const auto begin = std::chrono::steady_clock::now();
 
         // Create our inputs and outputs
         IInputPtr  input  = IInput::create(jawsMako, params.inputType);
@@ -541,17 +678,6 @@ int main(int argc, char *argv[])
         // Begin writing our empty document
         //outputWriter->beginDocument(document);
 
-        // Create the overprint simulation transform
-        IOverprintSimulationTransformPtr transform = IOverprintSimulationTransform::create(jawsMako);
-        transform->setSimulateBlackDeviceGrayTextOverprint(false);
-        transform->setResolution(600);
-
-        // Setup a renderer transform to perform transparency flattening.
-        IRendererTransformPtr renderer = IRendererTransform::create(jawsMako);
-        renderer->setTargetSpace(IDOMColorSpaceDeviceCMYK::create(jawsMako)); // Same colorspace as overprint transform
-        renderer->renderTransparentNodes(true); // Render transparent nodes
-        renderer->setResolution(600);
-
         // We're creating a booklet on landscape pages that when printed duplex, folded and stapled
         // will result in a booklet. All pages will be scaled to fit on an the target size and centered
         // as required.
@@ -575,88 +701,45 @@ int main(int argc, char *argv[])
         }
 
         // How many spreads will there be?
+        const uint32 pageCount = sourceDocument->getNumPages();
         uint32 numSpreads;
         if (params.sequential)
-            numSpreads = (sourceDocument->getNumPages() + 1) / 2;
+            numSpreads = (pageCount + 1) / 2;
         else
-    		numSpreads = (sourceDocument->getNumPages() + 3) / 4 * 2;
-
-        // So, for each spread
-        for (uint32 i = 0; i < numSpreads; i++)
-        {
-            // Pull the two pages required for the spread from the source document.
-            // Note that one or more of the sides may be blank
-            IPagePtr pageA;
-            uint32 pageANum;
-            if (params.sequential)
-                pageANum = i * 2;
-            else
-                pageANum = i;
-
-            if (pageANum < sourceDocument->getNumPages())
-            {
-                pageA = sourceDocument->getPage(pageANum);
-            }
-
-            IPagePtr pageB;
-            uint32 pageBNum;
-            if (params.sequential)
-                pageBNum = (i * 2) + 1;
-            else
-                pageBNum = (numSpreads * 2) - i - 1;
-
-            if (pageBNum < sourceDocument->getNumPages())
-            {
-                pageB = sourceDocument->getPage(pageBNum);
-            }
-
-            // If we're on an even spread (of a booklet), then pageA belongs on the right
-            if (!params.sequential && i % 2 == 0)
-            {
-                // Swap
-                IPagePtr tmp = pageA;
-                pageA = pageB;
-                pageB = tmp;
-            }
-
-            // Simulate overprint if required (transform the source pages)
-            if (params.simulateOverprint)
+    		numSpreads = (pageCount + 3) / 4 * 2;
+        const sImposition imposition = { sourceDocument, pageCount, numSpreads, spreadWidth, spreadHeight };
+
+        // Each spread is independent of the others, so they are built, and overprint simulated and transparency flattened,
+        // on a number of threads, a few spreads ahead of this one, which appends them to the output in order.
+        // Each thread borrows a set of transforms that no other is using, so there are only as many as there are threads.
+        const uint32 threadCount = params.threadCount ? params.threadCount : std::max(std::thread::hardware_concurrency(), 1u);
+        std::mutex transformsMutex;
+        std::vector<std::unique_ptr<sSpreadTransforms>> idleTransforms;
+        OrderedPrefetcher<IDOMFixedPagePtr> prefetcher(numSpreads, threadCount, threadCount * 2,
+            [&](uint32 spreadIndex, IDOMFixedPagePtr& spread)
             {
-                std::wcout << L"Simulating overprint on spread " << i << L"..." << std::endl;
-                // Drop overprint for DeviceCMYK text
-                if (pageA) {
-                    pageA->edit()->walkTree(dropOverprintForCMYKBlackText, jawsMako, true, true);
-                    transform->transformPage(pageA);
-                }
-                if (pageB) {
-                    pageB->edit()->walkTree(dropOverprintForCMYKBlackText, jawsMako, true, true);
-                    transform->transformPage(pageB);
+                std::unique_ptr<sSpreadTransforms> transforms;
+                {
+                    std::lock_guard<std::mutex> lock(transformsMutex);
+                    if (!idleTransforms.empty())
+                    {
+                        transforms = std::move(idleTransforms.back());
+                        idleTransforms.pop_back();
+                    }
                 }
-            }
-
-            // Create a new fixed page for the spread. Units are 1/96th of an inch
-            IDOMFixedPagePtr spread = IDOMFixedPage::create(jawsMako, spreadWidth, spreadHeight);
-
-            IPagePtr outputPage = sourceDocument->getPage(0);
-
-            // Copy in the data for the left page
-            imposePage(jawsMako, spread, pageA, true);
+                if (!transforms)
+                    transforms = createSpreadTransforms(jawsMako);
 
-            // And the right
-            imposePage(jawsMako, spread, pageB, false);
+                spread = buildSpread(jawsMako, params, imposition, *transforms, spreadIndex);
 
-            // Flatten transparency if required
-            if (params.flattenTransparency) {
-                std::wcout << L"Flattening spread " << i << L"..." << std::endl;
-                bool changed;
-                spread = edlobj2IDOMFixedPage(renderer->transform(spread, changed));
-                if (!spread)
-                {
-                    // This should never happen in practice.
-                    throw std::runtime_error("Result of transparency flattening is null or not a page!?");
-                }
-            }
+                std::lock_guard<std::mutex> lock(transformsMutex);
+                idleTransforms.push_back(std::move(transforms));
+            });
 
+        // So, for each spread, in order
+        IDOMFixedPagePtr spread;
+        while (prefetcher.take(spread))
+        {
             // Wrap in an IPage and write to the output
             IPagePtr page = IPage::create(jawsMako);
             page->setContent(spread);
@@ -672,9 +755,8 @@ int main(int argc, char *argv[])
         std::wcout << L"\'..." << std::endl;
         output->writeAssembly(assembly, params.outputFullPath);
 
-        clock_t end = clock();
-        double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
-        std::wcout << L"Elapsed time: " << elapsed_secs << L" seconds." << std::endl;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        std::wcout << L"Elapsed time: " << elapsed.count() << L" seconds." << std::endl;
         // Done!
     }
     catch (IError &e)
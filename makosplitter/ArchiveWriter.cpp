@@ -0,0 +1,335 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ArchiveWriter.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "ArchiveWriter.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+// CRC-32 as used by ZIP (polynomial 0xEDB88320)
+static uint32 crc32(const uint8* data, size_t length)
+{
+    static uint32 table[256];
+    static const bool tableBuilt = []
+    {
+        for (uint32 i = 0; i < 256; i++)
+        {
+            uint32 c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return true;
+    }();
+    (void)tableBuilt;
+
+    uint32 crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFF;
+}
+
+// Little-endian field helpers for ZIP records
+static void put16(std::vector<uint8>& record, uint16 value)
+{
+    record.push_back(value & 0xFF);
+    record.push_back(value >> 8);
+}
+
+static void put32(std::vector<uint8>& record, uint32 value)
+{
+    put16(record, value & 0xFFFF);
+    put16(record, value >> 16);
+}
+
+static void put64(std::vector<uint8>& record, uint64 value)
+{
+    put32(record, value & 0xFFFFFFFF);
+    put32(record, value >> 32);
+}
+
+// Constructor; opens the archive and starts the writer thread
+ArchiveWriter::ArchiveWriter(const String& path, const eFormat format, const size_t queueCapacity) :
+    m_file(nullptr), m_closeFile(false), m_format(format), m_entries(queueCapacity), m_offset(0), m_finished(false)
+{
+    if (path == L"-")
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        m_file = stdout;
+    }
+    else
+    {
+#ifdef _WIN32
+        m_file = _wfopen(path.c_str(), L"wb");
+#else
+        m_file = fopen(StringToU8String(path).c_str(), "wb");
+#endif
+        m_closeFile = true;
+    }
+    if (!m_file)
+    {
+        std::string message("Unable to create archive ");
+        message += StringToU8String(path).c_str();
+        throw std::runtime_error(message);
+    }
+
+    // Entries are stamped with the time the archive was created
+    const std::time_t now = std::time(nullptr);
+    const std::tm local = *std::localtime(&now);
+    m_dosTime = (uint16)((local.tm_hour << 11) | (local.tm_min << 5) | (local.tm_sec / 2));
+    m_dosDate = (uint16)(((std::max(local.tm_year, 80) - 80) << 9) | ((local.tm_mon + 1) << 5) | local.tm_mday);
+
+    m_thread = std::thread(&ArchiveWriter::writerThread, this);
+}
+
+// Destructor; an archive that was not finished is closed without its directory
+ArchiveWriter::~ArchiveWriter()
+{
+    if (!m_finished)
+    {
+        m_entries.close();
+        if (m_thread.joinable())
+            m_thread.join();
+        if (m_closeFile)
+            fclose(m_file);
+    }
+}
+
+// Determine the format from the archive name; anything other than .zip is written as TAR
+ArchiveWriter::eFormat ArchiveWriter::formatFromPath(const String& path)
+{
+    String extension = path.size() > 4 ? path.substr(path.size() - 4) : String();
+    std::transform(extension.begin(), extension.end(), extension.begin(), towlower);
+    return extension == L".zip" ? eZip : eTar;
+}
+
+// Hand over a file to be written to the archive. Waits if the queue of entries is full.
+void ArchiveWriter::add(const String& name, std::vector<uint8> data)
+{
+    sEntry entry;
+    entry.name = StringToU8String(name).c_str();
+    entry.crc = m_format == eZip ? crc32(data.data(), data.size()) : 0;
+    entry.data = std::move(data);
+    m_entries.push(std::move(entry));
+}
+
+// Write the remaining entries and complete the archive
+void ArchiveWriter::finish()
+{
+    m_entries.close();
+    m_thread.join();
+    if (!m_error.empty())
+        throw std::runtime_error(m_error);
+
+    if (m_format == eZip)
+        writeZipDirectory();
+    else
+        writeTarEnd();
+
+    fflush(m_file);
+    if (m_closeFile)
+        fclose(m_file);
+    m_finished = true;
+}
+
+// Write entries as they arrive. After a write error the remaining entries are discarded, and finish() reports it.
+void ArchiveWriter::writerThread()
+{
+    sEntry entry;
+    while (m_entries.pop(entry))
+    {
+        if (m_error.empty())
+        {
+            try
+            {
+                if (m_format == eZip)
+                    writeZipEntry(entry);
+                else
+                    writeTarEntry(entry);
+            }
+            catch (std::exception& e)
+            {
+                m_error = e.what();
+            }
+        }
+        entry = sEntry();
+    }
+}
+
+void ArchiveWriter::write(const void* data, const size_t length)
+{
+    if (fwrite(data, 1, length, m_file) != length)
+        throw std::runtime_error("Unable to write to archive");
+    m_offset += length;
+}
+
+// Write a local file header followed by the (stored) data
+void ArchiveWriter::writeZipEntry(const sEntry& entry)
+{
+    if (entry.data.size() >= 0xFFFFFFFF)
+        throw std::length_error("Archive entry too large");
+
+    sCentralRecord record = { entry.name, entry.crc, entry.data.size(), m_offset };
+
+    std::vector<uint8> header;
+    put32(header, 0x04034B50);                  // Local file header signature
+    put16(header, 20);                          // Version needed to extract
+    put16(header, 0x0800);                      // Flags: name is UTF-8
+    put16(header, 0);                           // Method: stored
+    put16(header, m_dosTime);
+    put16(header, m_dosDate);
+    put32(header, entry.crc);
+    put32(header, (uint32)entry.data.size());   // Compressed size
+    put32(header, (uint32)entry.data.size());   // Uncompressed size
+    put16(header, (uint16)entry.name.size());
+    put16(header, 0);                           // Extra field length
+    write(header.data(), header.size());
+    write(entry.name.data(), entry.name.size());
+    write(entry.data.data(), entry.data.size());
+
+    m_directory.push_back(record);
+}
+
+// Write the central directory and end records, using the ZIP64 forms where the counts or offsets require it
+void ArchiveWriter::writeZipDirectory()
+{
+    const uint64 directoryOffset = m_offset;
+    for (const auto& record : m_directory)
+    {
+        const bool zip64Offset = record.offset >= 0xFFFFFFFF;
+
+        std::vector<uint8> header;
+        put32(header, 0x02014B50);              // Central directory header signature
+        put16(header, 45);                      // Version made by
+        put16(header, zip64Offset ? 45 : 20);   // Version needed to extract
+        put16(header, 0x0800);
+        put16(header, 0);
+        put16(header, m_dosTime);
+        put16(header, m_dosDate);
+        put32(header, record.crc);
+        put32(header, (uint32)record.size);
+        put32(header, (uint32)record.size);
+        put16(header, (uint16)record.name.size());
+        put16(header, zip64Offset ? 12 : 0);    // Extra field length
+        put16(header, 0);                       // Comment length
+        put16(header, 0);                       // Disk number
+        put16(header, 0);                       // Internal attributes
+        put32(header, 0);                       // External attributes
+        put32(header, zip64Offset ? 0xFFFFFFFF : (uint32)record.offset);
+        write(header.data(), header.size());
+        write(record.name.data(), record.name.size());
+
+        if (zip64Offset)
+        {
+            std::vector<uint8> extra;
+            put16(extra, 0x0001);               // ZIP64 extended information
+            put16(extra, 8);
+            put64(extra, record.offset);
+            write(extra.data(), extra.size());
+        }
+    }
+    const uint64 directorySize = m_offset - directoryOffset;
+    const uint64 entryCount = m_directory.size();
+
+    std::vector<uint8> end;
+    if (entryCount >= 0xFFFF || directoryOffset >= 0xFFFFFFFF || directorySize >= 0xFFFFFFFF)
+    {
+        const uint64 zip64EndOffset = m_offset;
+        put32(end, 0x06064B50);                 // ZIP64 end of central directory record
+        put64(end, 44);
+        put16(end, 45);
+        put16(end, 45);
+        put32(end, 0);
+        put32(end, 0);
+        put64(end, entryCount);
+        put64(end, entryCount);
+        put64(end, directorySize);
+        put64(end, directoryOffset);
+        put32(end, 0x07064B50);                 // ZIP64 end of central directory locator
+        put32(end, 0);
+        put64(end, zip64EndOffset);
+        put32(end, 1);
+    }
+    put32(end, 0x06054B50);                     // End of central directory record
+    put16(end, 0);
+    put16(end, 0);
+    put16(end, (uint16)std::min<uint64>(entryCount, 0xFFFF));
+    put16(end, (uint16)std::min<uint64>(entryCount, 0xFFFF));
+    put32(end, (uint32)std::min<uint64>(directorySize, 0xFFFFFFFF));
+    put32(end, (uint32)std::min<uint64>(directoryOffset, 0xFFFFFFFF));
+    put16(end, 0);
+    write(end.data(), end.size());
+}
+
+// Fill in a TAR header block: octal fields, then the checksum over the whole block
+static void makeTarHeader(char (&block)[512], const std::string& name, uint64 size, char type)
+{
+    memset(block, 0, sizeof(block));
+    memcpy(block, name.data(), std::min<size_t>(name.size(), 100));
+    snprintf(block + 100, 8, "%07o", 0644);
+    snprintf(block + 108, 8, "%07o", 0);
+    snprintf(block + 116, 8, "%07o", 0);
+    snprintf(block + 124, 12, "%011llo", (unsigned long long)size);
+    snprintf(block + 136, 12, "%011llo", (unsigned long long)std::time(nullptr));
+    memset(block + 148, ' ', 8);
+    block[156] = type;
+    memcpy(block + 257, "ustar", 6);
+    memcpy(block + 263, "00", 2);
+
+    uint32 checksum = 0;
+    for (const char c : block)
+        checksum += (uint8)c;
+    snprintf(block + 148, 8, "%06o", checksum);
+}
+
+// Write a ustar header and the data, padded to a whole number of blocks.
+// Names too long for the header are carried in a PAX extended header.
+void ArchiveWriter::writeTarEntry(const sEntry& entry)
+{
+    static const char padding[512] = {};
+    char block[512];
+
+    if (entry.name.size() > 100)
+    {
+        // A PAX record is "<length> path=<name>\n", where the length includes its own digits
+        const std::string record = " path=" + entry.name + "\n";
+        size_t length = record.size() + 1;
+        while (std::to_string(length).size() + record.size() != length)
+            length++;
+        const std::string pax = std::to_string(length) + record;
+
+        makeTarHeader(block, "PaxHeader", pax.size(), 'x');
+        write(block, sizeof(block));
+        write(pax.data(), pax.size());
+        write(padding, (512 - pax.size() % 512) % 512);
+    }
+
+    makeTarHeader(block, entry.name, entry.data.size(), '0');
+    write(block, sizeof(block));
+    write(entry.data.data(), entry.data.size());
+    write(padding, (512 - entry.data.size() % 512) % 512);
+}
+
+// A TAR archive ends with two empty blocks
+void ArchiveWriter::writeTarEnd()
+{
+    static const char padding[1024] = {};
+    write(padding, sizeof(padding));
+}
@@ -0,0 +1,78 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ArchiveWriter.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "WorkQueue.h"
+
+using namespace EDL;
+using namespace JawsMako;
+
+// Writes files as the entries of a single ZIP or TAR archive, instead of as separate files.
+// Entries are handed over by the worker threads and written, in the order received, by a
+// thread of the archive's own, so the workers never wait on the file system unless the
+// (bounded) queue of entries waiting to be written is full.
+// ZIP entries are stored uncompressed, as PDF and XPS content is compressed already.
+class ArchiveWriter
+{
+public:
+    enum eFormat { eZip, eTar };
+
+    // A path of "-" writes the archive to stdout
+    ArchiveWriter(const String& path, eFormat format, size_t queueCapacity);
+    ~ArchiveWriter();
+
+    void add(const String& name, std::vector<uint8> data);
+    void finish();
+
+    static eFormat formatFromPath(const String& path);
+
+private:
+    struct sEntry
+    {
+        std::string name;       // UTF-8
+        std::vector<uint8> data;
+        uint32 crc;
+    };
+
+    struct sCentralRecord
+    {
+        std::string name;
+        uint32 crc;
+        uint64 size;
+        uint64 offset;
+    };
+
+    void writerThread();
+    void writeZipEntry(const sEntry& entry);
+    void writeZipDirectory();
+    void writeTarEntry(const sEntry& entry);
+    void writeTarEnd();
+    void write(const void* data, size_t length);
+
+    FILE* m_file;
+    bool m_closeFile;
+    eFormat m_format;
+    WorkQueue<sEntry> m_entries;
+    std::thread m_thread;
+    uint64 m_offset;
+    std::vector<sCentralRecord> m_directory;
+    uint16 m_dosTime;
+    uint16 m_dosDate;
+    std::string m_error;
+    bool m_finished;
+};
@@ -0,0 +1,184 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ChunkManifest.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "ChunkManifest.h"
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+static const char* manifestHeader = "makosplitter manifest 1";
+
+static FILE* openFile(const String& path, const char* mode)
+{
+#ifdef _WIN32
+    return _wfopen(path.c_str(), U8StringToString(mode).c_str());
+#else
+    return fopen(StringToU8String(path).c_str(), mode);
+#endif
+}
+
+static bool fileSize(const String& path, uint64& bytes)
+{
+#ifdef _WIN32
+    struct _stat64 statBuff;
+    if (_wstat64(path.c_str(), &statBuff) != 0)
+        return false;
+#else
+    struct stat statBuff;
+    if (stat(StringToU8String(path).c_str(), &statBuff) != 0)
+        return false;
+#endif
+    bytes = (uint64)statBuff.st_size;
+    return true;
+}
+
+// Size and 64-bit FNV-1a hash of a file's contents
+static bool hashFile(const String& path, uint64& bytes, uint64& hash)
+{
+    FILE* file = openFile(path, "rb");
+    if (!file)
+        return false;
+
+    std::vector<uint8> buffer(1024 * 1024);
+    bytes = 0;
+    hash = ChunkManifest::initialHash;
+    size_t bytesRead;
+    while ((bytesRead = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+    {
+        hash = ChunkManifest::hashBytes(hash, buffer.data(), bytesRead);
+        bytes += bytesRead;
+    }
+    const bool failed = ferror(file) != 0;
+    fclose(file);
+    return !failed;
+}
+
+static bool readLine(FILE* file, std::string& line)
+{
+    line.clear();
+    int c;
+    while ((c = getc(file)) != EOF && c != '\n')
+        line += (char)c;
+    return c != EOF || !line.empty();
+}
+
+// Parse a line of the form <first page>\t<last page>\t<bytes>\t<hash>\t<path>, pages counting from one
+static bool parseEntry(const std::string& line, ChunkManifest::sEntry& entry)
+{
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        const size_t tab = line.find('\t', start);
+        if (tab == std::string::npos)
+            return false;
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    fields.push_back(line.substr(start));
+
+    try
+    {
+        const uint32 firstPage = (uint32)std::stoul(fields[0]);
+        const uint32 lastPage = (uint32)std::stoul(fields[1]);
+        if (!firstPage || lastPage < firstPage || fields[4].empty())
+            return false;
+        entry.firstPage = firstPage - 1;
+        entry.pageCount = lastPage - firstPage + 1;
+        entry.bytes = std::stoull(fields[2]);
+        entry.hash = std::stoull(fields[3], nullptr, 16);
+        entry.outputFile = U8StringToString(fields[4].c_str());
+    }
+    catch (std::exception)
+    {
+        return false;
+    }
+    return true;
+}
+
+// A file is intact if it has the recorded size and hash; the size is checked first as it is cheap
+static bool verifyEntry(const ChunkManifest::sEntry& entry)
+{
+    uint64 bytes, hash;
+    return fileSize(entry.outputFile, bytes) && bytes == entry.bytes &&
+        hashFile(entry.outputFile, bytes, hash) && bytes == entry.bytes && hash == entry.hash;
+}
+
+ChunkManifest::ChunkManifest(const String& path, const String& inputFile) : m_file(nullptr)
+{
+    uint64 inputBytes = 0;
+    fileSize(inputFile, inputBytes);
+    const std::string inputLine = std::string("input\t") + std::to_string(inputBytes) + "\t" + StringToU8String(inputFile).c_str();
+
+    // Keep the entries of an earlier run of the same split whose files are intact
+    FILE* existing = openFile(path, "rb");
+    if (existing)
+    {
+        std::string line;
+        const bool sameInput = readLine(existing, line) && line == manifestHeader && readLine(existing, line) && line == inputLine;
+        while (sameInput && readLine(existing, line))
+        {
+            sEntry entry;
+            if (parseEntry(line, entry) && verifyEntry(entry))
+                m_written[entry.firstPage] = entry;
+        }
+        fclose(existing);
+    }
+
+    // Start the manifest afresh with those entries; new ones are added as the files are written
+    m_file = openFile(path, "wb");
+    if (!m_file)
+    {
+        std::string message("Unable to create manifest ");
+        message += StringToU8String(path).c_str();
+        throw std::runtime_error(message);
+    }
+    fprintf(m_file, "%s\n%s\n", manifestHeader, inputLine.c_str());
+    for (const auto& written : m_written)
+        writeEntry(written.second);
+    fflush(m_file);
+}
+
+ChunkManifest::~ChunkManifest()
+{
+    if (m_file)
+        fclose(m_file);
+}
+
+const ChunkManifest::sEntry* ChunkManifest::findWritten(const uint32 firstPage) const
+{
+    const auto found = m_written.find(firstPage);
+    return found != m_written.end() ? &found->second : nullptr;
+}
+
+uint64 ChunkManifest::hashBytes(uint64 hash, const void* data, const size_t size)
+{
+    const uint8* bytes = static_cast<const uint8*>(data);
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001B3ULL;
+    return hash;
+}
+
+void ChunkManifest::record(const uint32 firstPage, const uint32 pageCount, const String& outputFile, const uint64 bytes, const uint64 hash)
+{
+    const sEntry entry = { firstPage, pageCount, bytes, hash, outputFile };
+    std::lock_guard<std::mutex> lock(m_mutex);
+    writeEntry(entry);
+    fflush(m_file);
+}
+
+void ChunkManifest::writeEntry(const sEntry& entry)
+{
+    fprintf(m_file, "%u\t%u\t%llu\t%016llx\t%s\n", entry.firstPage + 1, entry.firstPage + entry.pageCount,
+        (unsigned long long)entry.bytes, (unsigned long long)entry.hash, StringToU8String(entry.outputFile).c_str());
+}
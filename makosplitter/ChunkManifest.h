@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ChunkManifest.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <cstdio>
+#include <map>
+#include <mutex>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// A record of the files written by a split, so that a split that was interrupted can be resumed.
+// Each line gives the page range of a chunk, and the path, size and hash of the file it was written to.
+// A line is added, and flushed, as each file is completed, so the record survives the split being killed.
+// When the manifest is opened again, the files it lists are checked, and only those that are intact are kept.
+class ChunkManifest
+{
+public:
+    struct sEntry
+    {
+        uint32 firstPage;       // Zero-based
+        uint32 pageCount;
+        uint64 bytes;
+        uint64 hash;
+        String outputFile;
+    };
+
+    // Loads and verifies the manifest, if there is one, then rewrites it with the entries that verified.
+    // Entries made by a split of a different input file (by path or size) are discarded.
+    ChunkManifest(const String& path, const String& inputFile);
+    ~ChunkManifest();
+
+    // The chunk starting at the given page written by an earlier run, if its file is intact
+    const sEntry* findWritten(uint32 firstPage) const;
+
+    // Record a file that has been written, with its size and hash, taken as it was written. May be called from any thread.
+    void record(uint32 firstPage, uint32 pageCount, const String& outputFile, uint64 bytes, uint64 hash);
+
+    // The 64-bit FNV-1a hash of the contents of a file, built up a block at a time from initialHash
+    static const uint64 initialHash = 0xCBF29CE484222325ULL;
+    static uint64 hashBytes(uint64 hash, const void* data, size_t size);
+
+    uint32 getWrittenCount() const
+    {
+        return (uint32)m_written.size();
+    }
+
+private:
+    void writeEntry(const sEntry& entry);
+
+    FILE* m_file;
+    std::mutex m_mutex;
+    std::map<uint32, sEntry> m_written;
+};
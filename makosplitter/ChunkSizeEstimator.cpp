@@ -0,0 +1,89 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ChunkSizeEstimator.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "ChunkSizeEstimator.h"
+
+#include <unordered_set>
+
+// Allowance for the page description itself, ie everything that is not an image
+static const double pageOverheadBytes = 8192.0;
+
+struct sResourceTally
+{
+    std::unordered_set<const void*> images;
+    double imageBytes;
+};
+
+// Add up the encoded size of the images painted on a page, counting an image painted more than once only once.
+// The images are not decoded; their streams are only asked for their length.
+static bool tallyImages(void* priv, const IDOMNodePtr& node)
+{
+    sResourceTally* tally = static_cast<sResourceTally*>(priv);
+
+    const IDOMPathNodePtr path = edlobj2IDOMPathNode(node);
+    if (!path)
+        return true;
+
+    const IDOMImageBrushPtr imageBrush = edlobj2IDOMImageBrush(path->getFill());
+    if (!imageBrush)
+        return true;
+
+    const IDOMImagePtr image = imageBrush->getImageSource();
+    if (image && tally->images.insert(&*image).second)
+    {
+        const IRAInputStreamPtr stream = image->getStream();
+        const int64 length = stream ? stream->length() : 0;
+        if (length > 0)
+            tally->imageBytes += double(length);
+    }
+    return true;
+}
+
+// Guess the output size of a page from its resources
+double ChunkSizeEstimator::guessPageBytes(const IPagePtr& page)
+{
+    sResourceTally tally;
+    tally.imageBytes = 0.0;
+    page->getContent()->walkTree(tallyImages, &tally, true, true);
+    return pageOverheadBytes + tally.imageBytes;
+}
+
+// Estimate the output size for a total of guessed bytes
+double ChunkSizeEstimator::estimate(const double guessedBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return guessedBytes * m_scale;
+}
+
+// Record the measured output size of a chunk, refining the scale applied to later guesses
+void ChunkSizeEstimator::record(const double guessedBytes, const uint64 measuredBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_guessedBytes += guessedBytes;
+    m_measuredBytes += double(measuredBytes);
+    m_scale = m_measuredBytes / m_guessedBytes;
+    m_measured.notify_all();
+}
+
+// Wait until at least one chunk has been measured, or none will be
+void ChunkSizeEstimator::waitForMeasurement()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_measured.wait(lock, [this] { return m_guessedBytes > 0 || m_abandoned; });
+}
+
+// Release any wait for a measurement, as a chunk failed and the split is being abandoned
+void ChunkSizeEstimator::abandon()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_abandoned = true;
+    m_measured.notify_all();
+}
@@ -0,0 +1,46 @@
+// -----------------------------------------------------------------------
+//  <copyright file="ChunkSizeEstimator.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <condition_variable>
+#include <mutex>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// Estimates how many bytes of output a page contributes, for splitting to a maximum file size.
+// Each page is first given a guess based on its resources, chiefly the encoded size of its images.
+// The guesses are then scaled by the ratio of measured output size to guessed size, taken over
+// all the chunks written so far, so the estimate improves as the split progresses.
+class ChunkSizeEstimator
+{
+public:
+    ChunkSizeEstimator() : m_guessedBytes(0), m_measuredBytes(0), m_scale(1.0), m_abandoned(false)
+    {
+    }
+
+    static double guessPageBytes(const IPagePtr& page);
+
+    double estimate(double guessedBytes);
+    void record(double guessedBytes, uint64 measuredBytes);
+    void waitForMeasurement();
+    void abandon();
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_measured;
+    double m_guessedBytes;
+    double m_measuredBytes;
+    double m_scale;
+    bool m_abandoned;
+};
@@ -0,0 +1,186 @@
+// -----------------------------------------------------------------------
+//  <copyright file="NavigationIndex.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "NavigationIndex.h"
+
+#include <algorithm>
+
+NavigationIndex::NavigationIndex(const IJawsMakoPtr& mako, const IDocumentPtr& document, const bool withDestinations) : m_mako(mako)
+{
+    for (uint32 i = 0; i < document->getNumPages(); i++)
+    {
+        IPagePtr page = document->getPage(i);
+        m_pageIndices[page->getPageId()] = i;
+        page->release();
+    }
+
+    IDOMOutlinePtr outline = document->getOutline();
+    if (outline)
+        indexOutline(outline->getOutlineTree()->getRoot());
+
+    if (withDestinations)
+    {
+        CNamedDestinationVect namedDestinations = document->getNamedDestinations();
+        for (uint32 i = 0; i < namedDestinations.size(); i++)
+        {
+            IDOMPageRectTargetPtr target = namedDestinations[i]->getTarget();
+            uint32 pageIndex;
+            if (target && findPageIndex(target->getPageId(), pageIndex))
+                m_destinations.push_back({ pageIndex, namedDestinations[i] });
+        }
+        std::stable_sort(m_destinations.begin(), m_destinations.end(),
+            [](const sDestination& a, const sDestination& b) { return a.pageIndex < b.pageIndex; });
+    }
+}
+
+bool NavigationIndex::findPageIndex(const DOMid pageId, uint32& pageIndex) const
+{
+    const auto found = m_pageIndices.find(pageId);
+    if (found == m_pageIndices.end())
+        return false;
+
+    pageIndex = found->second;
+    return true;
+}
+
+// Flatten the outline, walking it with a stack of the entries above the current one rather than by recursion
+void NavigationIndex::indexOutline(const IDOMOutlineTreeNodePtr& root)
+{
+    struct sLevel
+    {
+        IDOMOutlineTreeNodePtr node;
+        uint32 nextChild;
+        size_t position;
+    };
+
+    std::vector<sLevel> stack;
+    stack.push_back({ root, 0, 0 });
+    while (!stack.empty())
+    {
+        sLevel& level = stack.back();
+        if (level.nextChild == level.node->getChildrenCount())
+        {
+            // All the descendants of this entry have been indexed
+            if (stack.size() > 1)
+                m_outline[level.position].subtreeEnd = (uint32)m_outline.size();
+            stack.pop_back();
+            continue;
+        }
+
+        IDOMOutlineTreeNodePtr child = level.node->getChild(level.nextChild++);
+        sOutlineEntry outlineEntry = { IDOMOutlineEntryPtr(), IDOMPageRectTargetPtr(), noPage, (uint32)stack.size() - 1, 0, noPage, 0 };
+        IDOMTargetPtr target;
+        if (child->getData(outlineEntry.entry) && outlineEntry.entry->getTarget(target))
+        {
+            outlineEntry.target = edlobj2IDOMPageRectTarget(target);
+            if (outlineEntry.target)
+                findPageIndex(outlineEntry.target->getPageId(), outlineEntry.pageIndex);
+        }
+
+        m_outline.push_back(outlineEntry);
+        stack.push_back({ child, 0, m_outline.size() - 1 });
+    }
+
+    // Gather the range of pages targeted within each subtree, working back so the children are done first
+    for (size_t position = m_outline.size(); position-- > 0; )
+    {
+        sOutlineEntry& outlineEntry = m_outline[position];
+        if (outlineEntry.pageIndex != noPage)
+            outlineEntry.lowestPage = outlineEntry.highestPage = outlineEntry.pageIndex;
+        for (uint32 child = (uint32)position + 1; child < outlineEntry.subtreeEnd; child = m_outline[child].subtreeEnd)
+        {
+            const sOutlineEntry& childEntry = m_outline[child];
+            if (childEntry.lowestPage == noPage)
+                continue;
+            outlineEntry.lowestPage = std::min(outlineEntry.lowestPage, childEntry.lowestPage);
+            outlineEntry.highestPage = std::max(outlineEntry.highestPage, childEntry.highestPage);
+        }
+    }
+}
+
+// A copy of a target that points to another page
+IDOMPageRectTargetPtr NavigationIndex::retarget(const IDOMPageRectTargetPtr& target, const DOMid pageId) const
+{
+    return IDOMPageRectTarget::create(m_mako, pageId, target->getFitType(), target->getZoom(), target->getLeft(), target->getTop(), target->getRight(), target->getBottom());
+}
+
+void NavigationIndex::attach(const IDocumentPtr& targetDocument, const uint32 firstPage, const uint32 pageCount) const
+{
+    const uint32 endPage = firstPage + pageCount;
+
+    std::vector<DOMid> targetPageIds(pageCount);
+    for (uint32 i = 0; i < pageCount; i++)
+        targetPageIds[i] = targetDocument->getPage(i)->getPageId();
+
+    // Copy the outline entries for the range. The walk descends into an entry that is not copied, as its
+    // descendants may be, but skips straight past a subtree with no entry for the range.
+    struct sKept
+    {
+        uint32 depth;
+        IDOMOutlineTreeNodePtr node;
+    };
+    std::vector<sKept> kept;    // The copied entries above the current one
+    IDOMOutlineTreeNodePtr root;
+    uint32 position = 0;
+    while (position < m_outline.size())
+    {
+        const sOutlineEntry& outlineEntry = m_outline[position];
+        if (outlineEntry.lowestPage >= endPage || outlineEntry.highestPage < firstPage)
+        {
+            position = outlineEntry.subtreeEnd;
+            continue;
+        }
+
+        position++;
+        while (!kept.empty() && kept.back().depth >= outlineEntry.depth)
+            kept.pop_back();
+        if (outlineEntry.pageIndex < firstPage || outlineEntry.pageIndex >= endPage)
+            continue;
+
+        IDOMOutlineTreeNodePtr node = createInstance<IDOMOutlineTreeNode>(m_mako, CClassID(IDOMOutlineTreeNodeClassID));
+        if (!node)
+            continue;
+
+        if (!root)
+        {
+            IDOMOutlinePtr outline = targetDocument->getOutline();
+            if (!outline)
+            {
+                outline = IDOMOutline::create(m_mako);
+                targetDocument->setOutline(outline);
+            }
+            root = outline->getOutlineTree()->getRoot();
+        }
+
+        IDOMOutlineEntryPtr clonedEntry = clone(outlineEntry.entry, m_mako);
+        clonedEntry->setTarget(retarget(outlineEntry.target, targetPageIds[outlineEntry.pageIndex - firstPage]));
+        node->setData(clonedEntry);
+
+        // Attach to the nearest copied ancestor, or to the top level if none was copied
+        (kept.empty() ? root : kept.back().node)->appendChild(node);
+        kept.push_back({ outlineEntry.depth, node });
+    }
+
+    // Copy the named destinations for the range
+    if (m_destinations.empty())
+        return;
+
+    const auto first = std::lower_bound(m_destinations.begin(), m_destinations.end(), firstPage,
+        [](const sDestination& destination, uint32 pageIndex) { return destination.pageIndex < pageIndex; });
+    CNamedDestinationVect namedDestinations;
+    for (auto it = first; it != m_destinations.end() && it->pageIndex < endPage; ++it)
+    {
+        const IDOMPageRectTargetPtr target = retarget(it->destination->getTarget(), targetPageIds[it->pageIndex - firstPage]);
+        namedDestinations.append(INamedDestination::create(m_mako, it->destination->getName(), target));
+    }
+    if (!namedDestinations.empty())
+        targetDocument->setNamedDestinations(namedDestinations);
+}
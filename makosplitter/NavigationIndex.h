@@ -0,0 +1,67 @@
+// -----------------------------------------------------------------------
+//  <copyright file="NavigationIndex.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+#include <edl/idomoutline.h>
+
+#include <unordered_map>
+#include <vector>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// The bookmarks (outline) and named destinations of a document, indexed by the page they target.
+// Built once for the whole document, it lets each chunk of pages be given its share of them
+// without a deep copy of every page, or another pass over the document for every chunk.
+class NavigationIndex
+{
+public:
+    NavigationIndex(const IJawsMakoPtr& mako, const IDocumentPtr& document, bool withDestinations);
+
+    // Find the index of a page of the source document from its id
+    bool findPageIndex(DOMid pageId, uint32& pageIndex) const;
+
+    // Add the bookmarks and named destinations that target the given range of source pages to a document
+    // holding copies of those pages, in order. An entry whose parent is not kept is attached to its nearest
+    // kept ancestor, or to the top level if there is none.
+    // Safe to call from several threads at once.
+    void attach(const IDocumentPtr& targetDocument, uint32 firstPage, uint32 pageCount) const;
+
+private:
+    // An outline entry, in the order of a depth-first walk of the outline
+    struct sOutlineEntry
+    {
+        IDOMOutlineEntryPtr entry;
+        IDOMPageRectTargetPtr target;
+        uint32 pageIndex;       // noPage if the entry does not target a page of the document
+        uint32 depth;
+        uint32 subtreeEnd;      // The position of the entry that follows this entry's descendants
+        uint32 lowestPage;      // The lowest and highest pages targeted by the entry or its descendants;
+        uint32 highestPage;     // lowestPage is noPage if none of them targets a page
+    };
+
+    struct sDestination
+    {
+        uint32 pageIndex;
+        INamedDestinationPtr destination;
+    };
+
+    static const uint32 noPage = 0xFFFFFFFF;
+
+    void indexOutline(const IDOMOutlineTreeNodePtr& root);
+    IDOMPageRectTargetPtr retarget(const IDOMPageRectTargetPtr& target, DOMid pageId) const;
+
+    IJawsMakoPtr m_mako;
+    std::unordered_map<DOMid, uint32> m_pageIndices;
+    std::vector<sOutlineEntry> m_outline;
+    std::vector<sDestination> m_destinations;   // Sorted by page
+};
@@ -0,0 +1,204 @@
+// -----------------------------------------------------------------------
+//  <copyright file="PageSeparator.cpp" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#include "PageSeparator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Blank page detection renders at a low resolution, in 8-bit gray
+static const double blankCheckResolution = 36.0;
+
+// A pixel darker than this is ink; anything lighter is paper (or scanner noise)
+static constexpr uint8 inkThreshold = 0xF0;
+
+// The proportion of ink pixels a page may have and still be considered blank
+static const double blankInkRatio = 0.001;
+
+// The marker text is searched for in a window of the most recent text on the page, of at least this many characters
+static const size_t markerWindow = 256;
+
+// Constructor
+PageSeparator::PageSeparator(const IJawsMakoPtr& mako, const sSeparationCriteria& criteria) : m_mako(mako), m_criteria(criteria)
+{
+    if (m_criteria.blankPages)
+        m_renderer = IJawsRenderer::create(m_mako);
+}
+
+// Check a page against the criteria
+sPageScan PageSeparator::scan(const IPagePtr& page)
+{
+    sPageScan result = { false, false, page->getWidth(), page->getHeight() };
+
+    // Orientation is as displayed, so allow for the page being rotated
+    if ((page->getRotate() + 360) % 180 == 90)
+        std::swap(result.width, result.height);
+
+    if (m_criteria.blankPages || m_criteria.marker)
+    {
+        const IDOMFixedPagePtr content = page->getContent();
+        if (m_criteria.blankPages)
+            result.blank = isBlank(content);
+        if (m_criteria.marker && !result.blank)
+            result.marker = hasMarker(content);
+    }
+    return result;
+}
+
+// Count the ink pixels in a row. Eight pixels are tested at a time: if every byte in a word has all the
+// bits of the threshold set, each pixel is at least as light as the threshold and the word holds no ink.
+static uint32 countInk(const uint8* row, uint32 width)
+{
+    static_assert((uint8)(inkThreshold | (inkThreshold - 1)) == 0xFF, "the ink threshold must be a run of high bits");
+    const uint64 mask = 0x0101010101010101ULL * inkThreshold;
+
+    uint32 ink = 0;
+    uint32 x = 0;
+    for (; x + 8 <= width; x += 8)
+    {
+        uint64 word;
+        memcpy(&word, row + x, sizeof(word));
+        if ((word & mask) == mask)
+            continue;
+        for (uint32 i = 0; i < 8; i++)
+            if (row[x + i] < inkThreshold)
+                ink++;
+    }
+    for (; x < width; x++)
+        if (row[x] < inkThreshold)
+            ink++;
+    return ink;
+}
+
+// Is a solid colour dark enough to be ink? Only the device and sRGB spaces are judged; for any other, the page is rendered.
+static bool isInkColor(const IDOMColorPtr& color)
+{
+    const float paper = inkThreshold / 255.0f;
+    switch (color->getColorSpace()->getColorSpaceType())
+    {
+    case IDOMColorSpace::eDeviceGray:
+        return color->getComponentValue(0) < paper;
+    case IDOMColorSpace::eDeviceRGB:
+    case IDOMColorSpace::esRGB:
+        return 0.3f * color->getComponentValue(0) + 0.59f * color->getComponentValue(1) + 0.11f * color->getComponentValue(2) < paper;
+    case IDOMColorSpace::eDeviceCMYK:
+        return 0.3f * color->getComponentValue(0) + 0.59f * color->getComponentValue(1) + 0.11f * color->getComponentValue(2)
+            + color->getComponentValue(3) > 1.0f - paper;
+    default:
+        return false;
+    }
+}
+
+// Look for text that is surely ink: a run with something other than spaces, filled with a dark solid colour.
+// Images are not counted, as a scanned slip sheet is itself an image.
+static bool findInkText(void* priv, const IDOMNodePtr& node)
+{
+    bool* found = static_cast<bool*>(priv);
+
+    const IDOMGlyphsPtr glyphs = edlobj2IDOMGlyphs(node);
+    if (!glyphs)
+        return true;
+
+    const IDOMSolidColorBrushPtr brush = edlobj2IDOMSolidColorBrush(glyphs->getFill());
+    if (!brush || !isInkColor(brush->getColor()))
+        return true;
+
+    const std::wstring run = glyphs->getUnicodeString().c_str();
+    if (run.find_first_not_of(L" \t\r\n") == std::wstring::npos)
+        return true;
+
+    *found = true;
+    return false;
+}
+
+// Determine if a page is blank. A page with no content is blank without further ado, and one with dark text is not;
+// otherwise it is rendered at low resolution and its rows checked for ink, stopping as soon as there is too much.
+bool PageSeparator::isBlank(const IDOMFixedPagePtr& content) const
+{
+    if (!content->getFirstChild())
+        return true;
+
+    bool inkText = false;
+    content->walkTree(findInkText, &inkText, true, true);
+    if (inkText)
+        return false;
+
+    // Page units are 1/96th of an inch
+    const double pageWidth = content->getWidth();
+    const double pageHeight = content->getHeight();
+    const uint32 width = std::max(1u, (uint32)(pageWidth * blankCheckResolution / 96.0));
+    const IDOMImagePtr image = m_renderer->render(content, width, 8, IDOMColorSpaceDeviceGray::create(m_mako), FRect(0.0, 0.0, pageWidth, pageHeight));
+    const IImageFramePtr frame = image->getImageFrame(m_mako);
+
+    const uint32 frameWidth = frame->getWidth();
+    const uint32 frameHeight = frame->getHeight();
+    const uint32 inkAllowed = (uint32)(double(frameWidth) * frameHeight * blankInkRatio);
+
+    std::vector<uint8> row(frameWidth);
+    uint32 ink = 0;
+    for (uint32 y = 0; y < frameHeight; y++)
+    {
+        frame->readScanLine(row.data(), frameWidth);
+        ink += countInk(row.data(), frameWidth);
+        if (ink > inkAllowed)
+            return false;
+    }
+    return true;
+}
+
+// The most recent text of a page, kept both ways, as a word may be drawn a character at a time or runs may hold a word each
+struct sPageText
+{
+    const std::wregex* marker;
+    std::wstring joined;    // The runs one after the other
+    std::wstring spaced;    // The runs separated by spaces
+    bool found;
+};
+
+// Add a run of text to the window, search it, then drop all but the last markerWindow characters
+static bool searchWindow(std::wstring& window, const std::wregex& marker)
+{
+    const bool found = std::regex_search(window, marker);
+    if (window.size() > markerWindow)
+        window.erase(0, window.size() - markerWindow);
+    return found;
+}
+
+// Search the text of a page as it is drawn, stopping the walk at the first match
+static bool searchGlyphs(void* priv, const IDOMNodePtr& node)
+{
+    sPageText* text = static_cast<sPageText*>(priv);
+
+    const IDOMGlyphsPtr glyphs = edlobj2IDOMGlyphs(node);
+    if (!glyphs)
+        return true;
+
+    const std::wstring run = glyphs->getUnicodeString().c_str();
+    if (run.empty())
+        return true;
+
+    text->joined += run;
+    if (!text->spaced.empty())
+        text->spaced += L' ';
+    text->spaced += run;
+    text->found = searchWindow(text->joined, *text->marker) || searchWindow(text->spaced, *text->marker);
+    return !text->found;
+}
+
+// Determine if the text of a page matches the marker pattern. Each search only covers the window of recent text,
+// so the start of the page is not searched again and again, and text after the first match is never gathered.
+bool PageSeparator::hasMarker(const IDOMFixedPagePtr& content) const
+{
+    sPageText text = { m_criteria.marker.get(), std::wstring(), std::wstring(), false };
+    content->walkTree(searchGlyphs, &text, true, true);
+    return text.found;
+}
@@ -0,0 +1,62 @@
+// -----------------------------------------------------------------------
+//  <copyright file="PageSeparator.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+#include <jawsmako/jawsmako.h>
+
+#include <memory>
+#include <regex>
+
+using namespace EDL;
+using namespace JawsMako;
+
+// What marks the start of a new document within the source file
+struct sSeparationCriteria
+{
+    bool blankPages;    // A blank page (a slip sheet) separates documents; it is not itself output
+    bool sizeChanges;   // A change in page size or orientation starts a new document
+    std::shared_ptr<const std::wregex> marker;  // A page with text matching this pattern starts a new document.
+                                                // Compiled once, when the setting is read.
+};
+
+// Are any separation criteria set?
+inline bool isSeparating(const sSeparationCriteria& criteria)
+{
+    return criteria.blankPages || criteria.sizeChanges || criteria.marker;
+}
+
+// The findings for one page
+struct sPageScan
+{
+    bool blank;
+    bool marker;
+    double width;
+    double height;
+};
+
+// Scans pages for the separation criteria. The blank check stops as soon as it has its answer, so
+// a page is usually decided long before it would be fully rendered, and a page with dark text is
+// not rendered at all. The marker search likewise stops at the first match. Not thread safe; use one
+// instance per thread.
+class PageSeparator
+{
+public:
+    PageSeparator(const IJawsMakoPtr& mako, const sSeparationCriteria& criteria);
+    sPageScan scan(const IPagePtr& page);
+
+private:
+    bool isBlank(const IDOMFixedPagePtr& content) const;
+    bool hasMarker(const IDOMFixedPagePtr& content) const;
+
+    IJawsMakoPtr m_mako;
+    IJawsRendererPtr m_renderer;
+    sSeparationCriteria m_criteria;
+};
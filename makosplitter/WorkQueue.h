@@ -0,0 +1,77 @@
+// -----------------------------------------------------------------------
+//  <copyright file="WorkQueue.h" company="Global Graphics Software Ltd">
+//      Copyright (c) 2021 Global Graphics Software Ltd. All rights reserved.
+//  </copyright>
+//  <summary>
+//  This example is provided on an "as is" basis and without warranty of any kind.
+//  Global Graphics Software Ltd. does not warrant or make any representations regarding the use or
+//  results of use of this example.
+//  </summary>
+// -----------------------------------------------------------------------
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+// A queue of jobs shared by all worker threads. Rather than dealing jobs out to each
+// thread in advance, an idle worker takes the next job from the queue, so a thread held
+// up by a heavy job does not leave the others waiting for work that was assigned to it.
+//
+// The queue can be given a capacity, in which case push() waits for a free slot. This
+// lets a producer prepare jobs only a little ahead of the workers that consume them.
+template <typename T>
+class WorkQueue
+{
+public:
+    // A capacity of zero means the queue is unbounded
+    explicit WorkQueue(size_t capacity = 0) : m_capacity(capacity), m_closed(false)
+    {
+    }
+
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notFull.wait(lock, [this] { return !m_capacity || m_items.size() < m_capacity; });
+        m_items.push_back(std::move(item));
+        m_notEmpty.notify_one();
+    }
+
+    // Signal that no more jobs will be pushed; waiting workers finish once the queue drains
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+    }
+
+    // Take the next job, waiting for one if the queue is still open.
+    // Returns false when there is no more work.
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_notEmpty.wait(lock, [this] { return m_closed || !m_items.empty(); });
+        if (m_items.empty())
+            return false;
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+    std::deque<T> m_items;
+    size_t m_capacity;
+    bool m_closed;
+};
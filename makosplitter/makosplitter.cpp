@@ -10,8 +10,15 @@
 // -----------------------------------------------------------------------
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cmath>
 #include <exception>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <set>
 #include <stdexcept>
 #include <jawsmako/jawsmako.h>
 #include <jawsmako/pdfoutput.h>
@@ -20,12 +27,26 @@
 #include <vector>
 #include <jawsmako/xpsoutput.h>
 #include <jawsmako/pdfinput.h>
+#include "WorkQueue.h"
+#include "ChunkSizeEstimator.h"
+#include "PageSeparator.h"
+#include "ArchiveWriter.h"
+#include "ChunkManifest.h"
+#include "NavigationIndex.h"
 
 #ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
 #include <fcntl.h>
 #include <corecrt_io.h>
 #include <direct.h>
 typedef int mode_t;
+typedef HANDLE ProcessHandle;
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+typedef pid_t ProcessHandle;
 #endif
 
 #if defined(_WIN32)
@@ -47,14 +68,11 @@ using std::vector;
 using namespace JawsMako;
 using namespace EDL;
 
-struct sJob
+// A range of pages to be written to one output file
+struct sChunk
 {
-    uint32 chunkSize;
-    IDocumentPtr sourceDocument;
-    CEDLVector<IPagePtr> clonedPages;
-    eFileFormat outputType;
-    String outputFile;
-    bool deepCopy;
+    uint32 firstPage;
+    uint32 pageCount;
 };
 
 struct sParameters
@@ -67,8 +85,110 @@ struct sParameters
     String outputBasename;
     eFileFormat outputType;
     uint32 chunkSize;
+    uint32 threadCount;
+    uint32 window;
+    uint32 processCount;
+    uint32 firstPage;
+    uint32 lastPage;
+    uint32 bookmarkLevel;
+    uint64 maxBytes;
+    sSeparationCriteria separation;
+    String archivePath;
+    String manifestPath;
+    String batchInput;
+    uint32 openInputs;
+    bool createFolder;
     bool singleThread;
     bool deepCopy;
+    bool fullDeepCopy;
+};
+
+// Limits the number of inputs open at once (batch mode). A slot is taken before an input is opened,
+// and given back once the last job for the input has been written and the input released.
+struct sInputSlots
+{
+    explicit sInputSlots(uint32 count) : available(count)
+    {
+    }
+
+    void take()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        freed.wait(lock, [this] { return available > 0; });
+        available--;
+    }
+
+    void giveBack()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        available++;
+        freed.notify_one();
+    }
+
+    std::mutex mtx;
+    std::condition_variable freed;
+    uint32 available;
+};
+
+// An input being split, with its chunks planned. The jobs for the chunks share it, so it is
+// released as soon as the last of them is written, rather than when the whole run is over.
+struct sOpenInput
+{
+    ~sOpenInput()
+    {
+        navigation.reset();
+        document = IDocumentPtr();
+        assembly = IDocumentAssemblyPtr();
+        if (slots)
+            slots->giveBack();
+    }
+
+    sParameters params;
+    IDocumentAssemblyPtr assembly;
+    IDocumentPtr document;
+    uint32 firstPage = 0;
+    uint32 endPage = 0;
+    vector<sChunk> chunks;
+    std::unique_ptr<NavigationIndex> navigation;
+    ChunkSizeEstimator estimator;
+    sInputSlots* slots = nullptr;
+};
+
+// The first error from the jobs, passed on once the workers have finished. The jobs after it are skipped, rather than
+// written, so that the workers still empty the queue and the thread producing the jobs is never left waiting.
+struct sJobErrors
+{
+    void record(const std::exception_ptr& error)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (!first)
+            first = error;
+        failed = true;
+    }
+
+    std::mutex mtx;
+    std::exception_ptr first;
+    std::atomic<bool> failed{ false };
+};
+
+struct sJob
+{
+    uint32 firstPage;
+    uint32 chunkSize;
+    IDocumentPtr sourceDocument;
+    std::shared_ptr<sOpenInput> input;
+    CEDLVector<IPagePtr> clonedPages;
+    eFileFormat outputType;
+    String outputFile;
+    String outputBase;
+    bool deepCopy;
+    const NavigationIndex* navigation = nullptr;
+    uint64 maxBytes = 0;
+    vector<double> guessedPageBytes;
+    ChunkSizeEstimator* estimator = nullptr;
+    ArchiveWriter* archive = nullptr;
+    ChunkManifest* manifest = nullptr;
+    sJobErrors* errors = nullptr;
 };
 
 // Globals
@@ -83,6 +203,8 @@ static void usage()
     std::wcout << L"   Makosplitter input.xxx [output.yyy] [parameter=setting] [parameter=setting] ..." << std::endl;
     std::wcout << L" Where:" << std::endl;
     std::wcout << L"   input.xxx          source file from which to extract pages, where xxx is pdf, xps, pxl (PCL/XL) or pcl (PCL5)." << std::endl;
+    std::wcout << L"                        Or a batch of source files: a folder, a wildcard pattern (eg in/*.pdf) or a .txt file" << std::endl;
+    std::wcout << L"                        listing them, one per line. The output is then a folder, or a name in it giving the type." << std::endl;
     std::wcout << L"   output.yyy         target file to write the output to, where yyy is pdf, xps, pxl or pcl." << std::endl;
     std::wcout << L"                        If no output file is declared, <input>.pdf is assumed." << std::endl;
     std::wcout << L"   parameter=setting  one or more settings, described below." << std::endl;
@@ -92,8 +214,34 @@ static void usage()
     std::wcout << L"   c=<chunk size>     The number of pages per output file (omitted or 0 means one file per page)" << std::endl;
     std::wcout << L"   f=yes|no           Create a folder to contain the output, named according to the output file name. Default is no folder." << std::endl;
     std::wcout << L"   s=yes|no           Use a single thread (yes), otherwise multiple threads are used to write the output files, the default." << std::endl;
-    std::wcout << L"   d=yes|no           Use a deep copy of pages, ie copy bookmarks and form field metadata. May negatively impact performance." << std::endl;
-    std::wcout << L"                        Default is no." << std::endl;
+    std::wcout << L"   t=<threads>        The number of threads used to write the output files." << std::endl;
+    std::wcout << L"                        Omitted or 0 means one per available processor core. Ignored if s=yes." << std::endl;
+    std::wcout << L"   w=<chunks>         The number of chunks prepared ahead of the threads writing them, limiting memory use." << std::endl;
+    std::wcout << L"                        Omitted or 0 means twice the number of threads." << std::endl;
+    std::wcout << L"   p=<processes>      Split using a number of worker processes, each opening the input for itself and writing" << std::endl;
+    std::wcout << L"                        its share of the chunks. t= then sets the threads per process (default 1)." << std::endl;
+    std::wcout << L"                        Omitted or 0 means all chunks are written by threads of this process." << std::endl;
+    std::wcout << L"   r=<first>-<last>   Only split the given range of pages. Used to assign a range to each worker process." << std::endl;
+    std::wcout << L"   b=<level>          Split at each bookmark (outline entry) of the given level, eg 1 for one file per top-level bookmark." << std::endl;
+    std::wcout << L"                        Each file carries the bookmarks for its pages. c= and p= are ignored." << std::endl;
+    std::wcout << L"   maxbytes=<size>    Put as many pages in each output file as will fit in the given size, eg 10M. K, M and G" << std::endl;
+    std::wcout << L"                        suffixes are allowed. A single page larger than this is written on its own." << std::endl;
+    std::wcout << L"                        c=, b= and p= are ignored." << std::endl;
+    std::wcout << L"   sep=blank[,size]   Separate documents at blank pages (which are dropped) and/or where the page size or" << std::endl;
+    std::wcout << L"                        orientation changes. The pages are scanned in parallel. c= and p= are ignored." << std::endl;
+    std::wcout << L"   marker=<pattern>   Start a new document at each page with text matching the pattern (a regular" << std::endl;
+    std::wcout << L"                        expression), eg marker=\"Account No:\". May be combined with sep=." << std::endl;
+    std::wcout << L"                        A match may span at most 256 characters of text." << std::endl;
+    std::wcout << L"   a=<archive>        Write the output files as the entries of one archive instead of separate files." << std::endl;
+    std::wcout << L"                        A name ending .zip makes a ZIP archive, otherwise TAR; a=- writes TAR to stdout." << std::endl;
+    std::wcout << L"                        p= is ignored." << std::endl;
+    std::wcout << L"   m=<manifest>       Record the page range, size and hash of each output file in the manifest. If the manifest" << std::endl;
+    std::wcout << L"                        exists, output files it lists that are still intact are not written again, so an" << std::endl;
+    std::wcout << L"                        interrupted split can be resumed by running it again. Ignored if a= is used. p= is ignored." << std::endl;
+    std::wcout << L"   o=<inputs>         In batch mode, the maximum number of source files open at once. Omitted or 0 means 4." << std::endl;
+    std::wcout << L"   d=yes|full|no      Copy the bookmarks and named destinations that target the pages of each output file (yes)," << std::endl;
+    std::wcout << L"                        or use a full deep copy of pages, also copying form field metadata (full)." << std::endl;
+    std::wcout << L"                        A full deep copy may negatively impact performance. Default is no." << std::endl;
     //std::wcout << L"   z=on|off           Hidden option: Report filename as it is processed on STDERR (to support MakoDemo)" << std::endl;
 }
 
@@ -182,6 +330,137 @@ static String basename(const String &path)
     return path;
 }
 
+// Is there an extension on the filename (ignoring any dots in the folder names)?
+static bool hasExtension(const String& path)
+{
+    return filenameWithoutPrecedingPath(path).find_last_of('.') != String::npos;
+}
+
+// Is the input a batch of files: a folder, a wildcard pattern or a text file listing them?
+static bool isBatchInput(const String& path)
+{
+    if (path.find_first_of(L"*?") != String::npos)
+        return true;
+    if (hasExtension(path))
+    {
+        String extension = filenameWithoutPrecedingPath(path);
+        extension = extension.substr(extension.find_last_of('.'));
+        std::transform(extension.begin(), extension.end(), extension.begin(), towlower);
+        return extension == L".txt";
+    }
+    return fs::is_directory(fs::path(path.c_str()));
+}
+
+// Match a filename against a pattern with * and ? wildcards, ignoring case
+static bool matchesPattern(const wchar_t* name, const wchar_t* pattern)
+{
+    const wchar_t* star = nullptr;
+    const wchar_t* resume = nullptr;
+    while (*name)
+    {
+        if (*pattern == L'*')
+        {
+            star = pattern++;
+            resume = name;
+        }
+        else if (*pattern == L'?' || towlower(*pattern) == towlower(*name))
+        {
+            pattern++;
+            name++;
+        }
+        else if (star)
+        {
+            pattern = star + 1;
+            name = ++resume;
+        }
+        else
+            return false;
+    }
+    while (*pattern == L'*')
+        pattern++;
+    return !*pattern;
+}
+
+// Could the file be split? Other files in a folder of inputs are passed over
+static bool isInputFile(const String& path)
+{
+    try
+    {
+        fileFormatFromPath(path);
+        return true;
+    }
+    catch (std::exception)
+    {
+        return false;
+    }
+}
+
+// List the inputs of a batch: the files in a folder, those matching a wildcard pattern, or those listed
+// in a text file (UTF-8), one per line. Those in a folder, or matching a pattern, are listed in order of name.
+static vector<String> listBatchInputs(const String& batchInput)
+{
+    vector<String> inputs;
+    const bool isPattern = batchInput.find_first_of(L"*?") != String::npos;
+    if (isPattern || !hasExtension(batchInput))
+    {
+        const String folder = isPattern ? precedingPathWithoutFilename(batchInput) : batchInput;
+        const String pattern = isPattern ? filenameWithoutPrecedingPath(batchInput) : String(L"*");
+        for (const auto& entry : fs::directory_iterator(fs::path(folder.c_str())))
+        {
+            const String path = entry.path().wstring().c_str();
+            if (fs::is_regular_file(entry.path()) && isInputFile(path) &&
+                matchesPattern(filenameWithoutPrecedingPath(path).c_str(), pattern.c_str()))
+                inputs.push_back(path);
+        }
+        std::sort(inputs.begin(), inputs.end());
+    }
+    else
+    {
+#ifdef _WIN32
+        std::ifstream listStream(batchInput.c_str(), std::ios::binary);
+#else
+        std::ifstream listStream(StringToU8String(batchInput).c_str(), std::ios::binary);
+#endif
+        std::string line;
+        bool firstLine = true;
+        while (std::getline(listStream, line))
+        {
+            if (firstLine && line.compare(0, 3, "\xEF\xBB\xBF") == 0)
+                line.erase(0, 3);
+            firstLine = false;
+            while (line.size() && (line.back() == '\r' || line.back() == ' '))
+                line.pop_back();
+            if (line.size())
+                inputs.push_back(U8StringToString(U8String(line.c_str())));
+        }
+    }
+    return inputs;
+}
+
+// Create a folder if it does not already exist
+static void createFolder(const String& path)
+{
+    if (!path.size() || fs::exists(fs::path(path.c_str())))
+        return;
+
+    int nError = 0;
+#if defined(_WIN32)
+    wchar_t const* sPath = path.c_str();
+    nError = _wmkdir(sPath);
+#else
+    mode_t nMode = 0733;
+    U8String u8sPath = StringToU8String(path);
+    char const* sPath = u8sPath.c_str();
+    nError = mkdir(sPath, nMode);
+#endif
+    if (nError != 0)
+    {
+        std::string message("Unable to create folder ");
+        message += StringToU8String(path).c_str();
+        throw std::runtime_error(message);
+    }
+}
+
 bool isSeparator(std::wistream& source, const wchar_t separ)
 {
     wchar_t next;
@@ -205,7 +484,20 @@ static sParameters parseParams(CEDLStringVect arguments)
     params.inputType = eFFPDF;
     params.outputType = eFFPDF;
     params.chunkSize = 1;
+    params.threadCount = 0;
+    params.window = 0;
+    params.processCount = 0;
+    params.firstPage = 0;
+    params.lastPage = 0;
+    params.bookmarkLevel = 0;
+    params.maxBytes = 0;
+    params.separation.blankPages = false;
+    params.separation.sizeChanges = false;
     params.singleThread = false;
+    params.deepCopy = false;
+    params.fullDeepCopy = false;
+    params.openInputs = 0;
+    params.createFolder = false;
     makoDemoReporting = false;
 
     for (uint32 i = 0; i < arguments.size(); i++)
@@ -215,7 +507,23 @@ static sParameters parseParams(CEDLStringVect arguments)
         if (equalsPos == String::npos)
         {
             // A filename; first is input, second is output
-            if (params.inputFullPath.length() == 0)
+            if (params.inputFullPath.length() == 0 && params.batchInput.length() == 0 && isBatchInput(arguments[i]))
+            {
+                // A batch of inputs; any output given is the folder for the output files, or a name
+                // in that folder whose extension gives the output type, eg out/*.xps
+                params.batchInput = arguments[i];
+            }
+            else if (params.batchInput.length())
+            {
+                if (hasExtension(arguments[i]))
+                {
+                    params.outputPath = precedingPathWithoutFilename(arguments[i]);
+                    params.outputType = fileFormatFromPath(arguments[i]);
+                }
+                else
+                    params.outputPath = arguments[i];
+            }
+            else if (params.inputFullPath.length() == 0)
             {
                 params.inputFullPath = arguments[i];
                 params.inputType = fileFormatFromPath(arguments[i]);
@@ -251,8 +559,78 @@ static sParameters parseParams(CEDLStringVect arguments)
                 else if (setting == L"f")
                 {
                     transform(value.begin(), value.end(), value.begin(), towlower);
-                    if (value == L"yes" || value == L"true")
-                        params.outputPath += pathSeparator + params.outputBasename;
+                    params.createFolder = value == L"yes" || value == L"true";
+                }
+                else if (setting == L"t")
+                {
+                    wchar_t* end;
+                    params.threadCount = abs(std::wcstol(value.c_str(), &end, 10));
+                }
+                else if (setting == L"w")
+                {
+                    wchar_t* end;
+                    params.window = abs(std::wcstol(value.c_str(), &end, 10));
+                }
+                else if (setting == L"p")
+                {
+                    wchar_t* end;
+                    params.processCount = abs(std::wcstol(value.c_str(), &end, 10));
+                }
+                else if (setting == L"r")
+                {
+                    // A range of n- means from n to the end
+                    wchar_t* end;
+                    params.firstPage = abs(std::wcstol(value.c_str(), &end, 10));
+                    params.lastPage = *end == L'-' ? abs(std::wcstol(end + 1, &end, 10)) : params.firstPage;
+                }
+                else if (setting == L"b")
+                {
+                    wchar_t* end;
+                    params.bookmarkLevel = abs(std::wcstol(value.c_str(), &end, 10));
+                }
+                else if (setting == L"sep")
+                {
+                    transform(value.begin(), value.end(), value.begin(), towlower);
+                    std::wistringstream criteria(value.c_str());
+                    std::wstring criterion;
+                    while (std::getline(criteria, criterion, L','))
+                    {
+                        if (criterion == L"blank")
+                            params.separation.blankPages = true;
+                        else if (criterion == L"size")
+                            params.separation.sizeChanges = true;
+                        else
+                            throw std::invalid_argument("Unknown separation criterion");
+                    }
+                }
+                else if (setting == L"a")
+                {
+                    params.archivePath = value;
+                }
+                else if (setting == L"o")
+                {
+                    wchar_t* end;
+                    params.openInputs = abs(std::wcstol(value.c_str(), &end, 10));
+                }
+                else if (setting == L"m")
+                {
+                    params.manifestPath = value;
+                }
+                else if (setting == L"marker")
+                {
+                    params.separation.marker = std::make_shared<const std::wregex>(value.c_str());
+                }
+                else if (setting == L"maxbytes")
+                {
+                    wchar_t* end;
+                    params.maxBytes = std::wcstoull(value.c_str(), &end, 10);
+                    switch (towlower(*end))
+                    {
+                    case L'k': params.maxBytes <<= 10; break;
+                    case L'm': params.maxBytes <<= 20; break;
+                    case L'g': params.maxBytes <<= 30; break;
+                    default: break;
+                    }
                 }
                 else if (setting == L"s")
                 {
@@ -262,7 +640,8 @@ static sParameters parseParams(CEDLStringVect arguments)
                 else if (setting == L"d")
                 {
                     transform(value.begin(), value.end(), value.begin(), towlower);
-                    params.deepCopy = value == L"yes" || value == L"true";
+                    params.fullDeepCopy = value == L"full";
+                    params.deepCopy = value == L"yes" || value == L"true" || params.fullDeepCopy;
                 }
                 else if (setting == L"z")
                 {
@@ -279,23 +658,40 @@ static sParameters parseParams(CEDLStringVect arguments)
         }
     }
 
+    // Output to a folder of its own, named after the output file (in batch mode, after each input)
+    if (params.createFolder && !params.batchInput.length())
+        params.outputPath += pathSeparator + params.outputBasename;
+
     return params;
 }
 
-// Append one or more pages to a new assembly and document, then output as a new file
-static void writeChunk(IJawsMakoPtr& mako, uint32 chunkSize, IDocumentPtr sourceDocument, bool deepCopy, CEDLVector<IPagePtr> clonedPages, String& outputFile, IOutputPtr& output)
+// Return the page range to be added to the output filename
+static std::wstring pageIndex(const uint32 pageFrom, const uint32 pageCount)
 {
-IDocumentAssemblyPtr assembly = IDocumentAssembly::create(mako);
-IDocumentPtr document = IDocument::create(mako);
-for (uint32 i = 0; i < chunkSize; i++)
+    if (pageCount == 1)
+    {
+        return std::wstring(
+            std::wstring(L"_p") +
+            std::to_wstring(pageFrom)
+        );
+    }
+    return std::wstring (
+        std::wstring(L"_p") +
+        std::to_wstring(pageFrom) +
+        std::wstring(L"-") +
+        std::to_wstring(pageFrom + pageCount - 1)
+    );
+}
+
+// The name of the file for a chunk of pages
+static String chunkFileName(const sJob& job, const uint32 firstPage, const uint32 pageCount)
 {
-    if (!deepCopy)
-        document->appendPage(clonedPages[i]);
-    else
-        document->appendPage(clonedPages[i], sourceDocument);
+    return job.outputBase + pageIndex(firstPage + 1, pageCount).c_str() + extensionFromFormat(job.outputType);
 }
-assembly->appendDocument(document);
-output->writeAssembly(assembly, outputFile);
+
+// Report a file written, if requested
+static void reportOutput(const String& outputFile)
+{
     if (makoDemoReporting)
     {
         globalMtx.lock();
@@ -304,141 +700,628 @@ output->writeAssembly(assembly, outputFile);
     }
 }
 
-// Run the job
-static void threadRunner(IJawsMakoPtr mako, vector<sJob>* jobs)
+// Copy the contents of a temporary stream to a file, taking its size and hash (for the manifest) along the way
+static void copyToFile(IJawsMakoPtr& mako, const IRAInputStreamPtr& reader, const String& outputFile, uint64& bytes, uint64& hash)
+{
+    IOutputStreamPtr fileStream = IOutputStream::createToFile(mako->getFactory(), outputFile);
+    reader->open();
+    fileStream->open();
+    vector<char> buffer(1024 * 1024);
+    int32 bytesRead;
+    bytes = 0;
+    hash = ChunkManifest::initialHash;
+    while ((bytesRead = reader->read(buffer.data(), (int32)buffer.size())) > 0)
+    {
+        fileStream->completeWrite(buffer.data(), bytesRead);
+        hash = ChunkManifest::hashBytes(hash, buffer.data(), bytesRead);
+        bytes += bytesRead;
+    }
+    fileStream->close();
+    reader->close();
+}
+
+// Read the whole of a temporary stream into memory
+static vector<uint8> readAll(const IRAInputStreamPtr& reader)
+{
+    vector<uint8> data((size_t)reader->length());
+    reader->open();
+    size_t offset = 0;
+    int32 bytesRead;
+    while (offset < data.size() &&
+        (bytesRead = reader->read(data.data() + offset, (int32)std::min<size_t>(data.size() - offset, 1024 * 1024 * 1024))) > 0)
+        offset += bytesRead;
+    reader->close();
+    data.resize(offset);
+    return data;
+}
+
+// Deliver a chunk that was written to a temporary stream, either to its own file or to the archive (a=), noting
+// a file in the manifest (m=) if there is one. A manifest is not kept for an archive.
+static void deliverChunk(IJawsMakoPtr& mako, const sJob& job, const IRAInputStreamPtr& reader, uint32 firstPage, uint32 pageCount, const String& outputFile)
+{
+    if (job.archive)
+        job.archive->add(filenameWithoutPrecedingPath(outputFile), readAll(reader));
+    else
+    {
+        uint64 bytes;
+        uint64 hash;
+        copyToFile(mako, reader, outputFile, bytes, hash);
+        if (job.manifest)
+            job.manifest->record(firstPage, pageCount, outputFile, bytes, hash);
+    }
+    reportOutput(outputFile);
+}
+
+// Append one or more pages to a new assembly and document, then output as a new file
+static void writeChunk(IJawsMakoPtr& mako, const sJob& job, IOutputPtr& output)
+{
+    IDocumentAssemblyPtr assembly = IDocumentAssembly::create(mako);
+    IDocumentPtr document = IDocument::create(mako);
+    for (uint32 i = 0; i < job.chunkSize; i++)
+    {
+        if (!job.deepCopy)
+            document->appendPage(job.clonedPages[i]);
+        else
+            document->appendPage(job.clonedPages[i], job.sourceDocument);
+    }
+
+    // Add the bookmarks and named destinations that refer to the pages of this chunk, if any
+    if (job.navigation)
+        job.navigation->attach(document, job.firstPage, job.chunkSize);
+
+    assembly->appendDocument(document);
+
+    // A chunk for the archive, or one to be hashed for the manifest, is written to a temporary stream first
+    if (job.archive || job.manifest)
+    {
+        IRAInputStreamPtr reader;
+        IRAOutputStreamPtr writer;
+        mako->getTempStore()->createTemporaryReaderWriterPair(reader, writer);
+        output->writeAssembly(assembly, writer);
+        deliverChunk(mako, job, reader, job.firstPage, job.chunkSize, job.outputFile);
+    }
+    else
+    {
+        output->writeAssembly(assembly, job.outputFile);
+        reportOutput(job.outputFile);
+    }
+}
+
+// Write a chunk no larger than the maximum size (maxbytes=). The chunk is written to a temporary stream and measured.
+// If it is too large, the pages that should fit are written on their own, judging by the bytes per page of the attempt,
+// and the rest of the pages follow as further files. Every measurement refines the estimate used to plan later chunks.
+static void writeSizedChunk(IJawsMakoPtr& mako, const sJob& job, IOutputPtr& output)
+{
+    // A page can only be appended to one document, so a page tried in a chunk that was too large is cloned again
+    vector<bool> appended(job.chunkSize, false);
+
+    uint32 first = 0;
+    while (first < job.chunkSize)
+    {
+        uint32 count = job.chunkSize - first;
+        for (;;)
+        {
+            IDocumentAssemblyPtr assembly = IDocumentAssembly::create(mako);
+            IDocumentPtr document = IDocument::create(mako);
+            double guessedBytes = 0;
+            for (uint32 i = first; i < first + count; i++)
+            {
+                const IPagePtr page = appended[i] ? job.clonedPages[i]->clone() : job.clonedPages[i];
+                if (!job.deepCopy)
+                    document->appendPage(page);
+                else
+                    document->appendPage(page, job.sourceDocument);
+                appended[i] = true;
+                guessedBytes += job.guessedPageBytes[i];
+            }
+            if (job.navigation)
+                job.navigation->attach(document, job.firstPage + first, count);
+            assembly->appendDocument(document);
+
+            IRAInputStreamPtr reader;
+            IRAOutputStreamPtr writer;
+            mako->getTempStore()->createTemporaryReaderWriterPair(reader, writer);
+            output->writeAssembly(assembly, writer);
+            const uint64 measuredBytes = (uint64)reader->length();
+            job.estimator->record(guessedBytes, measuredBytes);
+
+            if (measuredBytes <= job.maxBytes || count == 1)
+            {
+                const String outputFile = chunkFileName(job, job.firstPage + first, count);
+                if (measuredBytes > job.maxBytes)
+                {
+                    globalMtx.lock();
+                    std::wcerr << L"Page " << job.firstPage + first + 1 << L" alone exceeds the maximum size (" << measuredBytes << L" bytes)." << std::endl;
+                    globalMtx.unlock();
+                }
+                deliverChunk(mako, job, reader, job.firstPage + first, count, outputFile);
+                break;
+            }
+
+            // Too large; keep as many pages as should fit, but at least one fewer than this attempt
+            const double bytesPerGuessedByte = double(measuredBytes) / guessedBytes;
+            uint32 keep = 0;
+            double keptBytes = 0;
+            while (keep < count - 1 && (keptBytes + job.guessedPageBytes[first + keep]) * bytesPerGuessedByte <= job.maxBytes * 0.95)
+                keptBytes += job.guessedPageBytes[first + keep++];
+            count = keep ? keep : 1;
+        }
+        first += count;
+    }
+}
+
+// Run jobs from the shared queue until it is empty. Each thread creates its own output and reuses it for every job it takes.
+// Should a job fail, its error is recorded and the jobs that follow are skipped.
+static void threadRunner(IJawsMakoPtr mako, WorkQueue<sJob>* jobs, eFileFormat outputType, sJobErrors* errors)
 {
-    IOutputPtr output = IOutput::create(mako, (*jobs)[0].outputType);
+    IOutputPtr output = IOutput::create(mako, outputType);
     // Make XPS output RGB (like regular MakoConverter)
     IXPSOutputPtr xpsOutput = obj2IXPSOutput(output);
     if (xpsOutput)
         xpsOutput->setTargetColorSpace(IDOMColorSpacesRGB::create(mako));
-    const size_t count = jobs->size();
-    for (size_t i = 0; i < count; ++i) {
-        sJob job = (*jobs)[i];
-        writeChunk(mako, job.chunkSize, job.sourceDocument, job.deepCopy, job.clonedPages, job.outputFile, output);
+    sJob job;
+    while (jobs->pop(job))
+    {
+        if (!errors->failed)
+        {
+            try
+            {
+                if (job.maxBytes)
+                    writeSizedChunk(mako, job, output);
+                else
+                    writeChunk(mako, job, output);
+            }
+            catch (...)
+            {
+                errors->record(std::current_exception());
+            }
+        }
+
+        // The producer may be waiting for this chunk to be measured (maxbytes=)
+        if (errors->failed && job.estimator)
+            job.estimator->abandon();
+
+        // Let go of the pages as soon as the chunk is written
+        job = sJob();
     }
 }
 
-// Return the page range to be added to the output filename
-static std::wstring pageIndex(const uint32 pageFrom, const uint32 pageCount)
+// Clone the pages of a job from the source document, releasing each source page once it is
+// cloned so the source document does not hold on to the content of every page it has loaded
+static void clonePages(const IDocumentPtr& document, sJob& job)
 {
-    if (pageCount == 1)
+    for (uint32 j = 0; j < job.chunkSize; j++)
     {
-        return std::wstring(
-            std::wstring(L"_p") +
-            std::to_wstring(pageFrom)
-        );
+        IPagePtr page = document->getPage(job.firstPage + j);
+        job.clonedPages.append(page->clone());
+        page->release();
     }
-    return std::wstring (
-        std::wstring(L"_p") +
-        std::to_wstring(pageFrom) +
-        std::wstring(L"-") +
-        std::to_wstring(pageFrom + pageCount - 1)
-    );
 }
 
-// Divide the PDF into chunks of the required size and set up job(s) to output the corresponding range of pages
-// Then run the jobs on the available threads
-void dumpChunks(IJawsMakoPtr mako, IDocumentPtr document, uint32 pageCount, uint32 chunkSize, String folder, String _outputFile, eFileFormat outputType, bool runSingleThreaded, bool deepCopy)
+// Divide a range of pages into chunks of the given size; the final chunk may be smaller
+static vector<sChunk> planFixedChunks(uint32 firstPage, uint32 endPage, uint32 chunkSize)
+{
+    vector<sChunk> chunks;
+    for (uint32 page = firstPage; page < endPage; page += chunkSize)
+        chunks.push_back({ page, std::min(chunkSize, endPage - page) });
+    return chunks;
+}
+
+// Collect the target page of each outline entry at the given level (1 being the top level)
+static void collectBookmarkPages(const IDOMOutlineTreeNodePtr& node, uint32 level, const NavigationIndex& navigation, std::set<uint32>& startPages)
 {
-    const uint32 chunkCount = pageCount / chunkSize;
-    const uint32 finalChunkSize = pageCount % chunkSize;
+    for (uint32 i = 0; i < node->getChildrenCount(); i++)
+    {
+        IDOMOutlineTreeNodePtr child = node->getChild(i);
+        if (level > 1)
+        {
+            collectBookmarkPages(child, level - 1, navigation, startPages);
+            continue;
+        }
 
-    // How many threads are there available?
-    unsigned int availableWorkers = thread::hardware_concurrency();
+        IDOMOutlineEntryPtr outlineEntry;
+        IDOMTargetPtr target;
+        if (!child->getData(outlineEntry) || !outlineEntry->getTarget(target))
+            continue;
+        IDOMPageRectTargetPtr rectTarget = edlobj2IDOMPageRectTarget(target);
+        if (!rectTarget)
+            continue; // Outline does not point to a page.
 
-    // Adjust number of available workers if they are not required
-    if (chunkCount == 0 || runSingleThreaded)
-        availableWorkers = 1;
-    else
-        if (chunkCount < availableWorkers)
-            availableWorkers = chunkCount;
+        uint32 pageIndex;
+        if (navigation.findPageIndex(rectTarget->getPageId(), pageIndex))
+            startPages.insert(pageIndex);
+    }
+}
 
-    unsigned int threadCount = availableWorkers - 1;
-    thread* workers = new thread[threadCount];
+// Divide a range of pages into chunks that start at the pages targeted by the outline entries of the given level.
+// Any pages before the first such entry form a chunk of their own.
+static vector<sChunk> planBookmarkChunks(const IDocumentPtr& document, const NavigationIndex& navigation, uint32 firstPage, uint32 endPage, uint32 level)
+{
+    std::set<uint32> startPages;
+    startPages.insert(firstPage);
 
-    // Create an array to hold the jobs
-    vector<sJob>* jobs = new vector<sJob>[availableWorkers];
+    IDOMOutlinePtr outline = document->getOutline();
+    if (outline)
+        collectBookmarkPages(outline->getOutlineTree()->getRoot(), level, navigation, startPages);
 
-    // Append a trailing separator
-    std::basic_string<wchar_t> pathSep(1, PATH_SEP_CHAR);
-    std::wstring folderPath(folder.c_str());
-    auto lastChar = folderPath.substr(folderPath.length() - 1);
-    if (lastChar.compare(pathSep) != 0)
-        folderPath += pathSep;
+    vector<sChunk> chunks;
+    for (auto it = startPages.lower_bound(firstPage); it != startPages.end() && *it < endPage; ++it)
+    {
+        auto next = std::next(it);
+        const uint32 chunkEnd = next != startPages.end() && *next < endPage ? *next : endPage;
+        chunks.push_back({ *it, chunkEnd - *it });
+    }
+    return chunks;
+}
 
-    int x = 0;
-    for (uint32 i = 0; i < chunkCount; ++i, ++x)
+// Scan pages on a number of threads, each with its own separator, taking the next page to scan as they go.
+// Should a page fail to scan, the error is recorded and the threads stop taking pages.
+static void scanPages(IJawsMakoPtr mako, IDocumentPtr document, const sSeparationCriteria* criteria, std::atomic<uint32>* nextPage, uint32 endPage,
+    vector<sPageScan>* scans, uint32 firstPage, sJobErrors* errors)
+{
+    try
     {
-        sJob job;
-        job.sourceDocument = document;
-        job.deepCopy = deepCopy;
-        job.outputType = outputType;
-        job.chunkSize = chunkSize;
-        for (uint32 j = 0; j < chunkSize; j++)
+        PageSeparator separator(mako, *criteria);
+        for (uint32 page = (*nextPage)++; page < endPage && !errors->failed; page = (*nextPage)++)
         {
-            job.clonedPages.append(document->getPage(i * chunkSize + j)->clone());
+            try
+            {
+                IPagePtr sourcePage = document->getPage(page);
+                (*scans)[page - firstPage] = separator.scan(sourcePage);
+                sourcePage->release();
+            }
+            catch (...)
+            {
+                errors->record(std::current_exception());
+            }
         }
+    }
+    catch (...)
+    {
+        errors->record(std::current_exception());
+    }
+}
 
-        std::wstring fullOutputPath(
-            folderPath + 
-            _outputFile.c_str());
-        std::wstring fullPath(
-            fullOutputPath +
-            pageIndex(i * chunkSize + 1, chunkSize) +
-            std::wstring(extensionFromFormat(outputType).c_str())
-        );
+// Divide a range of pages into chunks at the pages that meet the separation criteria (sep=, marker=). A blank page ends
+// a chunk and is dropped; a page with the marker text, or whose size or orientation differs from the one before, starts one.
+static vector<sChunk> planSeparatedChunks(const IJawsMakoPtr& mako, const IDocumentPtr& document, uint32 firstPage, uint32 endPage, const sParameters& params, unsigned int threadCount)
+{
+    vector<sPageScan> scans(endPage > firstPage ? endPage - firstPage : 0);
+    std::atomic<uint32> nextPage(firstPage);
 
-        job.outputFile = fullPath.c_str();
+    sJobErrors errors;
+    vector<thread> scanners(threadCount - 1);
+    for (auto& scanner : scanners)
+        scanner = thread(&scanPages, mako, document, &params.separation, &nextPage, endPage, &scans, firstPage, &errors);
+    scanPages(mako, document, &params.separation, &nextPage, endPage, &scans, firstPage, &errors);
+    for (auto& scanner : scanners)
+        scanner.join();
+    if (errors.first)
+        std::rethrow_exception(errors.first);
 
-        jobs[x].push_back(job);
-        if (x == availableWorkers - 1)
+    vector<sChunk> chunks;
+    const sPageScan* previous = nullptr;
+    for (uint32 i = 0; i < scans.size(); i++)
+    {
+        const sPageScan& scan = scans[i];
+        if (scan.blank)
         {
-            x = -1;
+            previous = nullptr;
+            continue;
         }
+
+        bool startsChunk = chunks.empty() || !previous || scan.marker;
+        if (previous && params.separation.sizeChanges)
+            startsChunk |= std::abs(scan.width - previous->width) > 1.0 || std::abs(scan.height - previous->height) > 1.0;
+
+        if (startsChunk)
+            chunks.push_back({ firstPage + i, 1 });
+        else
+            chunks.back().pageCount++;
+        previous = &scan;
     }
+    return chunks;
+}
+
+// The number of pages, from the given page, that an earlier run wrote to a file that is still intact (m=).
+// If pageCount is given, the file must hold exactly that many pages.
+static uint32 pagesAlreadyWritten(const sJob& prototype, uint32 firstPage, uint32 pageCount = 0)
+{
+    const ChunkManifest::sEntry* written = prototype.manifest ? prototype.manifest->findWritten(firstPage) : nullptr;
+    if (!written || (pageCount && written->pageCount != pageCount))
+        return 0;
+    return written->outputFile == chunkFileName(prototype, firstPage, written->pageCount) ? written->pageCount : 0;
+}
 
-    if (finalChunkSize)
+// Produce jobs sized to the maximum file size (maxbytes=). Pages are added to a job while the estimated size of the
+// chunk stays within 95% of the maximum; the estimate is refined as the workers measure the chunks they write. The first
+// job is produced on the initial guesses alone, and the rest wait for it to be measured.
+static void produceSizedJobs(IJawsMakoPtr& mako, const IDocumentPtr& document, uint32 firstPage, uint32 endPage,
+    const sParameters& params, const sJob& prototype, ChunkSizeEstimator& estimator, WorkQueue<sJob>& jobs)
+{
+    const double targetBytes = params.maxBytes * 0.95;
+
+    // The page that did not fit in the previous job, if any
+    IPagePtr nextPage;
+    double nextGuess = 0;
+
+    uint32 page = firstPage;
+    bool firstJob = true;
+    while (page < endPage && !prototype.errors->failed)
     {
-        sJob job;
-        job.sourceDocument = document;
-        job.deepCopy = deepCopy;
-        job.outputType = outputType;
-        job.chunkSize = finalChunkSize;
-        for (uint32 j = 0; j < finalChunkSize; j++)
+        // Skip past any file an earlier run wrote (m=)
+        const uint32 written = pagesAlreadyWritten(prototype, page);
+        if (written && page + written <= endPage)
         {
-            job.clonedPages.append(document->getPage(chunkCount * chunkSize + j)->clone());
+            page += written;
+            nextPage = IPagePtr();
+            continue;
         }
 
-        const std::wstring fullOutputPath(
-            folderPath +
-            _outputFile.c_str());
-        std::wstring fullPath(
-            fullOutputPath +
-            pageIndex(chunkCount * chunkSize + 1, finalChunkSize) +
-            std::wstring(extensionFromFormat(outputType).c_str())
-        );
+        sJob job = prototype;
+        job.maxBytes = params.maxBytes;
+        job.estimator = &estimator;
+        job.firstPage = page;
+        job.chunkSize = 0;
+
+        double guessedBytes = 0;
+        while (page < endPage)
+        {
+            if (job.chunkSize && pagesAlreadyWritten(prototype, page))
+                break;
+            if (!nextPage)
+            {
+                IPagePtr sourcePage = document->getPage(page);
+                nextPage = sourcePage->clone();
+                sourcePage->release();
+                nextGuess = ChunkSizeEstimator::guessPageBytes(nextPage);
+            }
+            if (job.chunkSize && estimator.estimate(guessedBytes + nextGuess) > targetBytes)
+                break;
 
-        job.outputFile = fullPath.c_str();
+            job.clonedPages.append(nextPage);
+            job.guessedPageBytes.push_back(nextGuess);
+            guessedBytes += nextGuess;
+            job.chunkSize++;
+            page++;
+            nextPage = IPagePtr();
+        }
 
-        jobs[x].push_back(job);
-        if (x == availableWorkers - 1)
+        jobs.push(job);
+        if (firstJob)
         {
-            x = -1;
+            estimator.waitForMeasurement();
+            firstJob = false;
         }
     }
-    
-    // Spawn worker threads
-    for (unsigned int i = 0; i < threadCount; ++i)
+}
+
+// Open the input, using the password if one was given
+static IDocumentAssemblyPtr openInput(const IJawsMakoPtr& mako, const sParameters& params)
+{
+    IInputPtr input = IInput::create(mako, params.inputType);
+    if (params.inputType == eFFPDF && params.userPassword.size())
+    {
+        IPDFInputPtr pdfInput = obj2IPDFInput(input);
+        if (pdfInput)
+            pdfInput->setPassword(params.userPassword);
+    }
+    return input->open(params.inputFullPath);
+}
+
+// The parameters for one input of a batch. Its output files are named after it, and written
+// to the output folder if one was given, otherwise alongside it.
+static sParameters inputParameters(const sParameters& params, const String& inputFile)
+{
+    sParameters inputParams = params;
+    inputParams.inputFullPath = inputFile;
+    inputParams.inputType = fileFormatFromPath(inputFile);
+    inputParams.inputBasename = basename(inputFile);
+    inputParams.outputBasename = inputParams.inputBasename;
+    if (!params.outputPath.size())
+        inputParams.outputPath = precedingPathWithoutFilename(inputFile);
+    if (params.createFolder)
     {
-        workers[i] = thread(&threadRunner, mako, &jobs[i]);
+        std::string p(1, PATH_SEP_CHAR);
+        inputParams.outputPath += U8StringToString(p.c_str()) + inputParams.outputBasename;
     }
+    return inputParams;
+}
+
+// Open an input, once one of the slots for open inputs is free, and plan its chunks
+static std::shared_ptr<sOpenInput> prepareInput(IJawsMakoPtr& mako, const sParameters& params, unsigned int threadCount, sInputSlots& slots)
+{
+    slots.take();
+    std::shared_ptr<sOpenInput> input = std::make_shared<sOpenInput>();
+    input->slots = &slots;
+    input->params = params;
+    input->assembly = openInput(mako, params);
+    input->document = input->assembly->getDocument();
 
-    // Run final (or only) job on the main thread (safe to do, as output is straightforward, autonomous process and does not need to be "listened" to)
-    threadRunner(mako, &jobs[threadCount]);
+    const uint32 pageCount = input->document->getNumPages();
+    if (!input->params.chunkSize) input->params.chunkSize = 1;    // One PDF per page
+    if (input->params.chunkSize > pageCount)
+        input->params.chunkSize = pageCount;        // Copy all pages to a single output PDF
+
+    // Restrict to the requested range of pages, if any
+    input->firstPage = params.firstPage ? std::min(params.firstPage, pageCount) - 1 : 0;
+    input->endPage = params.lastPage && params.lastPage < pageCount ? params.lastPage : pageCount;
+
+    // Index the bookmarks, and the named destinations if they are to be copied, so that each chunk can take its share
+    // of them (b=, d=yes). This is done once, up front, instead of a deep copy of every page. Mako already copies them
+    // with a full deep copy (d=full), but b= still needs the index to find the pages to split at.
+    if (params.bookmarkLevel || params.deepCopy)
+        input->navigation.reset(new NavigationIndex(mako, input->document, params.deepCopy && !params.fullDeepCopy));
+
+    // Plan the chunks, unless they are to be sized as they are produced
+    if (!params.maxBytes)
+    {
+        if (params.bookmarkLevel)
+            input->chunks = planBookmarkChunks(input->document, *input->navigation, input->firstPage, input->endPage, params.bookmarkLevel);
+        else if (isSeparating(params.separation))
+            input->chunks = planSeparatedChunks(mako, input->document, input->firstPage, input->endPage, params, threadCount);
+        else
+            input->chunks = planFixedChunks(input->firstPage, input->endPage, input->params.chunkSize);
+    }
+    return input;
+}
+
+// Produce the jobs for an input. Pushing a job waits while the window of chunks in flight is full.
+static void produceJobs(IJawsMakoPtr& mako, const std::shared_ptr<sOpenInput>& input, const sJob& runPrototype, WorkQueue<sJob>& jobs)
+{
+    const sParameters& params = input->params;
+
+    // Append a trailing separator
+    std::basic_string<wchar_t> pathSep(1, PATH_SEP_CHAR);
+    std::wstring folderPath(params.outputPath.c_str());
+    auto lastChar = folderPath.substr(folderPath.length() - 1);
+    if (lastChar.compare(pathSep) != 0)
+        folderPath += pathSep;
+
+    // What all the jobs for the input have in common
+    sJob prototype = runPrototype;
+    prototype.input = input;
+    prototype.sourceDocument = input->document;
+    if (!params.fullDeepCopy)
+        prototype.navigation = input->navigation.get();
+    prototype.outputBase = String(folderPath.c_str()) + params.outputBasename;
+
+    if (params.maxBytes)
+        produceSizedJobs(mako, input->document, input->firstPage, input->endPage, params, prototype, input->estimator, jobs);
+
+    for (uint32 i = 0; i < input->chunks.size() && !prototype.errors->failed; ++i)
+    {
+        if (pagesAlreadyWritten(prototype, input->chunks[i].firstPage, input->chunks[i].pageCount))
+            continue;
+
+        sJob job = prototype;
+        job.firstPage = input->chunks[i].firstPage;
+        job.chunkSize = input->chunks[i].pageCount;
+        clonePages(input->document, job);
+
+        job.outputFile = chunkFileName(job, job.firstPage, job.chunkSize);
+
+        jobs.push(job);
+    }
+}
+
+// Divide each input into chunks, of the required size, at the chosen level of bookmarks or up to a maximum file size,
+// and run a job for each to output the corresponding range of pages.
+// The jobs are written by the requested number of threads, each taking the next job from a shared queue, while this
+// thread prepares the jobs no more than a few chunks ahead of them. Pages are therefore only cloned shortly before
+// they are written, and released straight after, so memory use does not grow with the length of the document.
+// A batch of inputs shares the one set of threads. The next input is opened while the jobs for those before it are
+// still being written, up to the limit on open inputs, and each is released when the last of its jobs is written.
+// Returns the number of inputs of a batch that could not be split; for a single input, errors are passed on.
+uint32 dumpChunks(IJawsMakoPtr mako, const sParameters& params, const vector<String>& inputFiles)
+{
+    const bool batch = params.batchInput.size() != 0;
+
+    // How many threads are to be used? If not specified, use as many as are available
+    unsigned int availableWorkers = params.threadCount ? params.threadCount : thread::hardware_concurrency();
+    if (availableWorkers == 0 || params.singleThread)
+        availableWorkers = 1;
+
+    // How many inputs may be open at once? If not specified, allow one being prepared while three are written
+    sInputSlots slots(params.openInputs ? params.openInputs : 4);
+
+    // A single input is prepared before the threads are started, so that no more are started than it has jobs
+    std::shared_ptr<sOpenInput> input;
+    if (!batch)
+    {
+        input = prepareInput(mako, params, availableWorkers, slots);
+
+        // Adjust number of available workers if they are not required
+        const uint32 jobCount = params.maxBytes ? input->endPage - input->firstPage : (uint32)input->chunks.size();
+        if (jobCount <= 1 || params.singleThread)
+            availableWorkers = 1;
+        else
+            if (jobCount < availableWorkers)
+                availableWorkers = jobCount;
+    }
+
+    // The queue of jobs, shared by all the threads. Its capacity is the number of chunks in flight.
+    const uint32 window = params.window ? params.window : availableWorkers * 2;
+    WorkQueue<sJob> jobs(window);
+
+    // Write to an archive, if requested, rather than to separate files. The archive's writer thread
+    // accepts no more finished chunks than there are jobs in the window before the workers have to wait.
+    std::unique_ptr<ArchiveWriter> archive;
+    if (params.archivePath.size())
+        archive.reset(new ArchiveWriter(params.archivePath, ArchiveWriter::formatFromPath(params.archivePath), window));
+
+    // Keep a manifest of the files written, if requested, skipping those an earlier run left intact.
+    // The entries of an archive cannot be checked one by one, so a manifest is not kept for one, nor for a batch.
+    std::unique_ptr<ChunkManifest> manifest;
+    if (params.manifestPath.size() && !archive && !batch)
+        manifest.reset(new ChunkManifest(params.manifestPath, params.inputFullPath));
+
+    // Spawn worker threads; they wait for jobs to arrive on the queue
+    sJobErrors errors;
+    vector<thread> workers(availableWorkers);
+    for (unsigned int i = 0; i < availableWorkers; ++i)
+    {
+        workers[i] = thread(&threadRunner, mako, &jobs, params.outputType, &errors);
+    }
+
+    // What all the jobs have in common
+    sJob prototype;
+    prototype.deepCopy = params.fullDeepCopy;
+    prototype.outputType = params.outputType;
+    prototype.archive = archive.get();
+    prototype.manifest = manifest.get();
+    prototype.errors = &errors;
+
+    // Produce the jobs. Should preparing a job fail, the workers are still allowed to finish before the error is
+    // passed on; in a batch, the error is reported and the next input is split. Should writing a job fail, no more
+    // jobs are produced, and the error is passed on once the workers have finished.
+    uint32 failures = 0;
+    try
+    {
+        if (input)
+        {
+            produceJobs(mako, input, prototype, jobs);
+            input.reset();
+        }
+
+        for (uint32 i = 0; batch && i < inputFiles.size() && !errors.failed; ++i)
+        {
+            try
+            {
+                const sParameters inputParams = inputParameters(params, inputFiles[i]);
+                createFolder(inputParams.outputPath);
+                input = prepareInput(mako, inputParams, availableWorkers, slots);
+                produceJobs(mako, input, prototype, jobs);
+                input.reset();
+            }
+            catch (IError& e)
+            {
+                input.reset();
+                const String errorFormatString = getEDLErrorString(e.getErrorCode());
+                std::wcerr << L"Unable to split " << inputFiles[i] << L": " << e.getErrorDescription(errorFormatString) << std::endl;
+                failures++;
+            }
+            catch (std::exception& e)
+            {
+                input.reset();
+                std::wcerr << L"Unable to split " << inputFiles[i] << L": " << e.what() << std::endl;
+                failures++;
+            }
+        }
+    }
+    catch (...)
+    {
+        jobs.close();
+        for (unsigned int i = 0; i < availableWorkers; ++i)
+            workers[i].join();
+        throw;
+    }
+
+    // No more jobs; the workers exit once the queue is drained
+    jobs.close();
 
     // Wait for the worker threads to finish
-    for (unsigned int i = 0; i < threadCount; ++i)
+    for (unsigned int i = 0; i < availableWorkers; ++i)
     {
         if (workers[i].joinable())
         {
@@ -446,8 +1329,127 @@ void dumpChunks(IJawsMakoPtr mako, IDocumentPtr document, uint32 pageCount, uint
         }
     }
 
-    delete[] jobs;
-    delete[] workers;
+    // Pass on the error from any job that failed
+    if (errors.first)
+        std::rethrow_exception(errors.first);
+
+    // Write the last of the entries and complete the archive
+    if (archive)
+        archive->finish();
+
+    if (manifest && manifest->getWrittenCount())
+        std::wcout << manifest->getWrittenCount() << L" file(s) written by an earlier run were intact and kept." << std::endl;
+
+    return failures;
+}
+
+// Start a worker process, running this program with the given arguments
+static bool spawnWorker(const String& executable, const CEDLStringVect& arguments, ProcessHandle& process)
+{
+#ifdef _WIN32
+    std::wstring commandLine = L"\"" + std::wstring(executable.c_str()) + L"\"";
+    for (uint32 i = 0; i < arguments.size(); i++)
+        commandLine += L" \"" + std::wstring(arguments[i].c_str()) + L"\"";
+
+    STARTUPINFOW startupInfo = { sizeof(startupInfo) };
+    PROCESS_INFORMATION processInfo;
+    if (!CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo))
+        return false;
+    CloseHandle(processInfo.hThread);
+    process = processInfo.hProcess;
+    return true;
+#else
+    vector<std::string> args;
+    args.push_back(StringToU8String(executable).c_str());
+    for (uint32 i = 0; i < arguments.size(); i++)
+        args.push_back(StringToU8String(arguments[i]).c_str());
+
+    vector<char*> argv;
+    for (auto& arg : args)
+        argv.push_back(&arg[0]);
+    argv.push_back(nullptr);
+
+    return posix_spawnp(&process, argv[0], nullptr, nullptr, argv.data(), environ) == 0;
+#endif
+}
+
+// Wait for a worker process to finish and return its exit code
+static int waitForWorker(ProcessHandle process)
+{
+#ifdef _WIN32
+    DWORD exitCode = 1;
+    WaitForSingleObject(process, INFINITE);
+    GetExitCodeProcess(process, &exitCode);
+    CloseHandle(process);
+    return (int)exitCode;
+#else
+    int status = 0;
+    if (waitpid(process, &status, 0) == -1)
+        return 1;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+#endif
+}
+
+// Divide the chunks between a number of worker processes. Each worker is this program, run with the same arguments
+// plus a page range (r=); it opens the input with its own IJawsMako instance, so nothing is shared between them.
+// The ranges fall on chunk boundaries, so the output is the same as when running threads in a single process.
+// Returns the number of workers that failed.
+static uint32 runWorkerProcesses(const String& executable, const CEDLStringVect& arguments, const sParameters& params, uint32 pageCount)
+{
+    const uint32 chunkTotal = (pageCount + params.chunkSize - 1) / params.chunkSize;
+    const uint32 processCount = std::min(params.processCount, chunkTotal);
+
+    // Pass on the arguments, except the number of processes. Unless set, each worker writes on a single thread.
+    CEDLStringVect workerArguments;
+    for (uint32 i = 0; i < arguments.size(); i++)
+    {
+        String setting = arguments[i].substr(0, 2);
+        std::transform(setting.begin(), setting.end(), setting.begin(), towlower);
+        if (setting != L"p=")
+            workerArguments.append(arguments[i]);
+    }
+    if (!params.threadCount)
+        workerArguments.append(L"t=1");
+
+    struct sWorker
+    {
+        uint32 firstPage;
+        uint32 lastPage;
+        ProcessHandle process;
+        bool started;
+    };
+    vector<sWorker> workers(processCount);
+
+    // Give each worker a contiguous range of chunks, sharing out any remainder one chunk each
+    uint32 chunk = 0;
+    for (uint32 i = 0; i < processCount; i++)
+    {
+        const uint32 chunks = chunkTotal / processCount + (i < chunkTotal % processCount ? 1 : 0);
+        workers[i].firstPage = chunk * params.chunkSize + 1;
+        workers[i].lastPage = std::min((chunk + chunks) * params.chunkSize, pageCount);
+        chunk += chunks;
+
+        CEDLStringVect args = workerArguments;
+        args.append(String(L"r=") + std::to_wstring(workers[i].firstPage).c_str() + L"-" + std::to_wstring(workers[i].lastPage).c_str());
+        workers[i].started = spawnWorker(executable, args, workers[i].process);
+    }
+
+    // Wait for the workers and report the results
+    uint32 failures = 0;
+    for (uint32 i = 0; i < processCount; i++)
+    {
+        const int exitCode = workers[i].started ? waitForWorker(workers[i].process) : -1;
+        std::wcout << L"Worker " << i + 1 << L" (pages " << workers[i].firstPage << L"-" << workers[i].lastPage << L"): ";
+        if (!workers[i].started)
+            std::wcout << L"could not be started." << std::endl;
+        else if (exitCode)
+            std::wcout << L"failed with exit code " << exitCode << L"." << std::endl;
+        else
+            std::wcout << L"done." << std::endl;
+        if (exitCode)
+            failures++;
+    }
+    return failures;
 }
 
 // Program entry point
@@ -491,6 +1493,27 @@ int main(int argc, char *argv[])
         const IJawsMakoPtr jawsMako = IJawsMako::create();
         IJawsMako::enableAllFeatures(jawsMako);
 
+        // Split a batch of inputs, sharing one set of threads
+        if (params.batchInput.size())
+        {
+            const auto begin = std::chrono::steady_clock::now();
+
+            const vector<String> inputFiles = listBatchInputs(params.batchInput);
+            if (inputFiles.empty())
+            {
+                std::wcerr << L"No input files found in " << params.batchInput << L". " << std::endl;
+                return 1;
+            }
+            createFolder(params.outputPath);
+            const uint32 failures = dumpChunks(jawsMako, params, inputFiles);
+
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            std::wostream& console = params.archivePath == L"-" ? std::wcerr : std::wcout;
+            console << inputFiles.size() - failures << L" of " << inputFiles.size() << L" input files split." << std::endl;
+            console << L"Elapsed time: " << elapsed.count() << L" seconds." << std::endl;
+            return failures ? 1 : 0;
+        }
+
         // Check the input file exists
         if (!fs::exists(params.inputFullPath))
         {
@@ -499,55 +1522,45 @@ int main(int argc, char *argv[])
         }
 
         // Check output folder exists; create if not
-        if (params.outputPath.size())
+        createFolder(params.outputPath);
+
+        // Run as a number of worker processes if requested (but not if this is one of the workers)
+        if (params.processCount && !params.firstPage && !params.bookmarkLevel && !params.maxBytes && !isSeparating(params.separation) && !params.archivePath.size() && !params.manifestPath.size())
         {
-            if (!fs::exists(params.outputPath))
+            const auto begin = std::chrono::steady_clock::now();
+
+            // Only the page count is needed here; the document is released before the workers open it for themselves
+            uint32 pageCount;
             {
-                int nError = 0;
-#if defined(_WIN32)
-                wchar_t const* sPath = params.outputPath.c_str();
-                nError = _wmkdir(sPath);
-#else
-                mode_t nMode = 0733;
-                U8String u8sPath = StringToU8String(params.outputPath);
-                char const* sPath = u8sPath.c_str();
-                nError = mkdir(sPath, nMode);
-#endif
-                if (nError != 0) {
-                    std::wcerr << L"Unable to create folder " << params.outputPath << L". " << std::endl;
-                    return 1;
-                }
+                IDocumentAssemblyPtr assembly = openInput(jawsMako, params);
+                pageCount = assembly->getDocument()->getNumPages();
             }
-        }
+            if (!params.chunkSize) params.chunkSize = 1;    // One PDF per page
+            if (params.chunkSize > pageCount)
+                params.chunkSize = pageCount;        // Copy all pages to a single output PDF
 
-        // Timer
-        const clock_t begin = clock();
+#ifdef _WIN32
+            const String executable = argv[0];
+#else
+            const String executable = U8StringToString(U8String(argv[0]));
+#endif
+            const uint32 failures = pageCount ? runWorkerProcesses(executable, argString, params, pageCount) : 0;
 
-        // Create an input
-        IInputPtr input = IInput::create(jawsMako, params.inputType);
-        if (params.inputType == eFFPDF && params.userPassword.size())
-        {
-            IPDFInputPtr pdfInput = obj2IPDFInput(input);
-            if (pdfInput)
-                pdfInput->setPassword(params.userPassword);
+            const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+            std::wcout << L"Elapsed time: " << elapsed.count() << L" seconds." << std::endl;
+            return failures ? 1 : 0;
         }
 
-        // Get the assembly from the input
-        IDocumentAssemblyPtr assembly = input->open(params.inputFullPath);
-
-        // Grab the document and page count
-        IDocumentPtr document = assembly->getDocument();
-        const uint32 pageCount = document->getNumPages();
-        if (!params.chunkSize) params.chunkSize = 1;    // One PDF per page
-        if (params.chunkSize > pageCount)
-            params.chunkSize = pageCount;        // Copy all pages to a single output PDF
+        // Timer; wall-clock time, as clock() would add up the time of every thread
+        const auto begin = std::chrono::steady_clock::now();
 
         // Output the document "chunks"
-        dumpChunks(jawsMako, document, pageCount, params.chunkSize, params.outputPath, params.outputBasename, params.outputType, params.singleThread, params.deepCopy);
+        dumpChunks(jawsMako, params, vector<String>(1, params.inputFullPath));
 
-        const clock_t end = clock();
-        const double elapsed_secs = double(end - begin) / CLOCKS_PER_SEC;
-        std::wcout << L"Elapsed time: " << elapsed_secs << L" seconds." << std::endl;
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - begin;
+        // Keep stdout clean if the archive is being written to it
+        std::wostream& console = params.archivePath == L"-" ? std::wcerr : std::wcout;
+        console << L"Elapsed time: " << elapsed.count() << L" seconds." << std::endl;
 
         return 0;
     }